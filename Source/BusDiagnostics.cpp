@@ -0,0 +1,78 @@
+#include "BusDiagnostics.hpp"
+
+#include <algorithm>
+
+// How many of the busiest addresses Dump lists
+constexpr size_t BUS_DIAGNOSTIC_TOP_ADDRESSES = 32;
+
+BusDiagnostics::BusDiagnostics()
+{
+    Counts.resize(BUS_DIAGNOSTIC_COUNT * (ADDRESS_MASK + 1));
+    Clear();
+}
+
+void BusDiagnostics::Clear()
+{
+    std::fill(Counts.begin(), Counts.end(), 0);
+
+    for (auto& access : History) {
+        access = {};
+    }
+
+    Next = 0;
+    Total = 0;
+}
+
+void BusDiagnostics::Dump(FILE * file) const
+{
+    fprintf(file, "Bus diagnostics: %llu unusual accesses\n", (unsigned long long)Total);
+
+    if (Total == 0) {
+        return;
+    }
+
+    struct Entry
+    {
+        uint32_t Count;
+        word Address;
+        byte Kind;
+    };
+
+    std::vector<Entry> entries;
+
+    for (size_t kind = 0; kind < BUS_DIAGNOSTIC_COUNT; ++kind) {
+        uint64_t total = 0;
+
+        for (size_t address = 0; address <= ADDRESS_MASK; ++address) {
+            uint32_t count = Counts[(kind * (ADDRESS_MASK + 1)) + address];
+            if (count > 0) {
+                entries.push_back({ count, (word)address, (byte)kind });
+                total += count;
+            }
+        }
+
+        if (total > 0) {
+            fprintf(file, "  %-20s %llu\n", BUS_DIAGNOSTIC_NAMES[kind], (unsigned long long)total);
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.Count > b.Count;
+    });
+
+    fprintf(file, "Busiest addresses:\n");
+    for (size_t i = 0; i < std::min(entries.size(), BUS_DIAGNOSTIC_TOP_ADDRESSES); ++i) {
+        const auto& entry = entries[i];
+        fprintf(file, "  %04X %-20s %u\n", entry.Address, BUS_DIAGNOSTIC_NAMES[entry.Kind], entry.Count);
+    }
+
+    // Oldest first, starting from the one that is about to be overwritten
+    size_t count = std::min<uint64_t>(Total, BUS_DIAGNOSTIC_HISTORY);
+    size_t start = (Next + BUS_DIAGNOSTIC_HISTORY - count) % BUS_DIAGNOSTIC_HISTORY;
+
+    fprintf(file, "Last %zu accesses:\n", count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto& access = History[(start + i) % BUS_DIAGNOSTIC_HISTORY];
+        fprintf(file, "  cycle %llu: %-20s %04X = %02X\n", (unsigned long long)access.Cycle, BUS_DIAGNOSTIC_NAMES[access.Kind], access.Address, access.Data);
+    }
+}
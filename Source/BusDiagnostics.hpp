@@ -0,0 +1,90 @@
+#ifndef BUS_DIAGNOSTICS_HPP
+#define BUS_DIAGNOSTICS_HPP
+
+#include <Config.hpp>
+#include <Constants.hpp>
+
+#include <cstdio>
+#include <vector>
+
+// Accesses that don't do anything on this emulator, which usually means a missing feature or a misbehaving ROM
+constexpr byte BUS_UNDEFINED_TIA_READ   = 0;
+constexpr byte BUS_UNDEFINED_TIA_WRITE  = 1;
+constexpr byte BUS_UNDEFINED_RIOT_READ  = 2;
+constexpr byte BUS_UNDEFINED_RIOT_WRITE = 3;
+constexpr byte BUS_UNMAPPED_READ        = 4;
+constexpr byte BUS_UNMAPPED_WRITE       = 5;
+constexpr byte BUS_ROM_WRITE            = 6;
+
+constexpr size_t BUS_DIAGNOSTIC_COUNT = 7;
+
+constexpr const char * BUS_DIAGNOSTIC_NAMES[BUS_DIAGNOSTIC_COUNT] = {
+    "Undefined TIA read",
+    "Undefined TIA write",
+    "Undefined RIOT read",
+    "Undefined RIOT write",
+    "Unmapped read",
+    "Unmapped write",
+    "ROM write",
+};
+
+// The most recent accesses kept, older ones are only counted
+constexpr size_t BUS_DIAGNOSTIC_HISTORY = 256;
+
+struct BusAccess
+{
+    uint64_t Cycle;
+
+    word Address;
+
+    byte Data;
+
+    // One of BUS_*
+    byte Kind;
+
+}; // struct BusAccess
+
+// Counts every unusual access by address, and keeps the last few with when they happened
+// Only built with FREYA2600_BUS_DIAGNOSTICS, which Debug builds turn on, so release builds pay nothing for it
+class BusDiagnostics
+{
+public:
+
+    BusDiagnostics();
+
+    inline void Record(byte kind, word address, byte data, uint64_t cycle) {
+        address = (address & ADDRESS_MASK);
+
+        ++Counts[(kind * (ADDRESS_MASK + 1)) + address];
+
+        History[Next] = { cycle, address, data, kind };
+        Next = (Next + 1) % BUS_DIAGNOSTIC_HISTORY;
+        ++Total;
+    }
+
+    // Prints the totals, the busiest addresses, and the recent history
+    void Dump(FILE * file) const;
+
+    void Clear();
+
+private:
+
+    // BUS_DIAGNOSTIC_COUNT runs of one counter per address
+    std::vector<uint32_t> Counts;
+
+    BusAccess History[BUS_DIAGNOSTIC_HISTORY];
+
+    // Where the next access goes in History
+    size_t Next = 0;
+
+    uint64_t Total = 0;
+
+}; // class BusDiagnostics
+
+#if defined(FREYA2600_BUS_DIAGNOSTICS)
+    #define BUS_DIAGNOSTIC(kind, address, data) Diagnostics.Record((kind), (address), (data), CPUCycleCount)
+#else
+    #define BUS_DIAGNOSTIC(kind, address, data) ((void)0)
+#endif
+
+#endif // BUS_DIAGNOSTICS_HPP
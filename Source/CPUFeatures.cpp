@@ -0,0 +1,32 @@
+#include "CPUFeatures.hpp"
+
+#if defined(FREYA2600_X86)
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+#endif
+
+bool HasAVX2()
+{
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+
+    // OSXSAVE and AVX
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+        return false;
+    }
+
+    // XMM and YMM state
+    if ((_xgetbv(0) & 0x06) != 0x06) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#endif // FREYA2600_X86
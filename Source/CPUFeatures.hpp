@@ -0,0 +1,27 @@
+#ifndef CPU_FEATURES_HPP
+#define CPU_FEATURES_HPP
+
+// Vector kernels are built for several instruction sets and pick one at runtime, with a scalar fallback
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define FREYA2600_X86
+    #include <immintrin.h>
+
+    // GCC and Clang only allow the intrinsics of an instruction set in functions built for it
+    // MSVC allows them anywhere, so the runtime checks are all it needs
+    #if defined(__GNUC__)
+        #define FREYA2600_TARGET(ISA) __attribute__((target(ISA)))
+    #else
+        #define FREYA2600_TARGET(ISA)
+    #endif
+#endif
+
+#if defined(FREYA2600_X86)
+
+// SSE2 is always there on x86-64, so AVX2 is the only one checked for
+// Also checks that the OS saves the AVX registers
+bool HasAVX2();
+
+#endif // FREYA2600_X86
+
+#endif // CPU_FEATURES_HPP
@@ -6,14 +6,15 @@
 
 constexpr size_t ROM_BANK_SIZE = 4096;
 constexpr size_t ROM_HALF_BANK_SIZE = ROM_BANK_SIZE / 2;
-constexpr size_t MAX_BANKS = 8;
-constexpr size_t BANK_SWITCH_ADDRESS = 0x1000;
+constexpr size_t MAX_BANKS = 128; // 512K, the most a 3F cartridge can address
 
 constexpr uint16_t ADDRESS_MASK = 0b0001'1111'1111'1111;
 
 constexpr size_t SCREEN_WIDTH = 160;
 constexpr size_t SCREEN_HEIGHT = 192;
-constexpr size_t SCREEN_BUFFER_SIZE = SCREEN_WIDTH * SCREEN_HEIGHT * 3; // RGB
+
+// Past the 128 colors of the palette, for the checkerboard drawn during VBLANK
+constexpr uint8_t VBLANK_MAGENTA_INDEX = 128;
 
 constexpr size_t DISPLAY_WIDTH = 320;
 constexpr size_t DISPLAY_HEIGHT = 240;
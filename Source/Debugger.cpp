@@ -119,6 +119,9 @@ void Debugger::Render()
         Emu->DoFrame();
     }
 
+    // One copy of everything the panels show, so drawing them can't disturb the emulator
+    Emu->TakeSnapshot(&State);
+
     SetCursor(10, 50);
     DrawRegisters();
     
@@ -147,8 +150,8 @@ void Debugger::Render()
     panelMouse.x -= panel.TopLeft.x;
     panelMouse.y -= panel.TopLeft.y;
     
-    word entrypoint = Emu->ReadWord(0xFFFC, false);
-    word interrupt = Emu->ReadWord(0xFFFE, false);
+    word entrypoint = Emu->PeekWord(0xFFFC);
+    word interrupt = Emu->PeekWord(0xFFFE);
 
     uint16_t searchAddress = (Emu->PC & ADDRESS_MASK);
 
@@ -177,6 +180,10 @@ void Debugger::Render()
 
     if (!addressFound) {
         printf("Unknown address %04X\n", searchAddress);
+
+        // Picked up from the start next time this ROM is loaded
+        Disassemble(Emu->PC, true);
+        Emu->AddDisassemblyRoot(Emu->PC);
     }
 
     static int scroll = 0;
@@ -245,6 +252,11 @@ void Debugger::Render()
 
                 if (MouseReleased) {
                     Breakpoint = address;
+
+#if defined(FREYA2600_JIT)
+                    // Translated blocks don't check for breakpoints
+                    Emu->InvalidateNativeCode();
+#endif
                 }
             }
             else {
@@ -610,28 +622,28 @@ void Debugger::DrawRegisters()
         "A  ${2:02X} #{2:<3d} %{2:08b}\n"
         "X  ${3:02X} #{3:<3d} %{3:08b}\n"
         "Y  ${4:02X} #{4:<3d} %{4:08b}\n",
-        Emu->PC,
-        Emu->SP,
-        Emu->A,
-        Emu->X,
-        Emu->Y
+        State.PC,
+        State.SP,
+        State.A,
+        State.X,
+        State.Y
     ));
 
     DrawText(fmt::format(
         "SR {}{}-{}{}{}{}{}\n",
-        (Emu->N ? 'N' : '-'),
-        (Emu->V ? 'V' : '-'),
-        (Emu->D ? 'D' : '-'),
-        (Emu->B ? 'B' : '-'),
-        (Emu->I ? 'I' : '-'),
-        (Emu->Z ? 'Z' : '-'),
-        (Emu->C ? 'C' : '-')
+        (State.SR & 0x80 ? 'N' : '-'),
+        (State.SR & 0x40 ? 'V' : '-'),
+        (State.SR & 0x08 ? 'D' : '-'),
+        (State.SR & 0x10 ? 'B' : '-'),
+        (State.SR & 0x04 ? 'I' : '-'),
+        (State.SR & 0x02 ? 'Z' : '-'),
+        (State.SR & 0x01 ? 'C' : '-')
     ));
 }
 
 void Debugger::DrawRAM()
 {
-    const auto& ram = Emu->RAM;
+    const auto& ram = State.RAM;
 
     DrawHeading("RAM");
 
@@ -654,7 +666,7 @@ void Debugger::DrawRAM()
 
     DrawText("0x 00 01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F\n");
 
-    if (Emu->SP >= 0x80) {
+    if (State.SP >= 0x80) {
         SDL_Rect stack = {
             .x = Cursor.x + (3 * FONT_GLYPH_WIDTH) - 2,
             .y = Cursor.y + 1,
@@ -662,8 +674,8 @@ void Debugger::DrawRAM()
             .h = FONT_LINE_HEIGHT - 1,
         };
 
-        int row = (Emu->SP / 0x10) - 8;
-        int col = (Emu->SP % 0x10);
+        int row = (State.SP / 0x10) - 8;
+        int col = (State.SP % 0x10);
         stack.x += col * 3 * FONT_GLYPH_WIDTH;
         stack.y += row * FONT_LINE_HEIGHT;
 
@@ -679,7 +691,7 @@ void Debugger::DrawRAM()
     
     SetTextColor(COLOR_TEXT);
     
-    for (int off = 0; off < sizeof(Emu->RAM); off += 16) {
+    for (int off = 0; off < sizeof(State.RAM); off += 16) {
         DrawText(fmt::format(
             "   "
             "{:02X} {:02X} {:02X} {:02X} "
@@ -703,10 +715,10 @@ void Debugger::DrawTimer()
         "TIMINT   {}\n"
         "Counter #{}\n"
         "Divider #{}\n",
-        Emu->INTIM,
-        Emu->TIMINT._raw,
-        Emu->TimerCounter,
-        Emu->TimerInterval
+        State.INTIM,
+        State.TIMINT,
+        State.TimerCounter,
+        State.TimerInterval
     ));
 }
 
@@ -825,106 +837,13 @@ void Debugger::DrawIO()
 
 void Debugger::Disassemble(word address, bool jumped /*= false*/)
 {
-    // printf("Disassembling %04X\n", address);
-
-    auto it = InstructionMap.find(address);
-    if (it != InstructionMap.end()) {
-        if (jumped) {
-            it->second.JumpDestination = true;
-        }
-        
-        return;
-    }
-
-    // InstructionRecord record(Emu, address);
-
-    // Suck it std::map
-    auto [newIt, _] = InstructionMap.emplace(address, InstructionRecord(Emu, address));
-    
-    InstructionRecord& record = newIt->second;
-    
-    if (jumped) {
-        record.JumpDestination = true;
-    }
-
-    // if (!FirstInstruction) {
-    //     FirstInstruction = record;
-    //     goto next; // fuck it
-    // }
-
-    // if (FirstInstruction->Address > address) {
-    //     record.Next = FirstInstruction;
-    //     FirstInstruction->Prev = record;
-    //     FirstInstruction = record;
-    //     goto next;
-    // }
-
-    // ptr = FirstInstruction;
-    // while (ptr->Next) {
-    //     if (ptr->Address < address) {
-    //         if (ptr->Next->Address > address) {
-    //             record.Next = ptr->Next;
-    //             record.Prev = ptr;
-    //             ptr->Next = record;
-    //             goto next;
-    //         }
-    //     }
-
-    //     ptr = ptr->Next;
-    // }
-
-    // ptr->Next = record;
-    // record.Prev = ptr;
-
-// next:
-
-    if (record.Opcodes[0] == 0x40 || // RTI
-        record.Opcodes[0] == 0x60) { // RTS
-        return;
-    }
-    else if (record.Opcodes[0] == 0x00) { // BRK
-        address = Emu->ReadWord(0xFFFE, false);
-        Disassemble(address, true);
-        return;
-    }
-    else if (record.Opcodes[0] == 0x4C) { // JMP Absolute
-        address = (record.Opcodes[2] << 8) | record.Opcodes[1];
-        Disassemble(address, true);
-        return;
-    }
-    else if (record.Opcodes[0] == 0x6C) { // JMP (Absolute)
-        address = (record.Opcodes[2] << 8) | record.Opcodes[1];
-        address = Emu->ReadWord(address, false);
-        Disassemble(address, true);
-        return;
-    }
-    else if (record.Opcodes[0] == 0x20) { // JSR Absolute
-        word dest = (record.Opcodes[2] << 8) | record.Opcodes[1];
-        Disassemble(dest, true);
-    }
-    else if (IsIn(record.Opcodes[0], {
-            0x10, // BPL
-            0x30, // BMI
-            0x50, // BVC
-            0x70, // BVS
-            0x90, // BCC
-            0xB0, // BCS
-            0xD0, // BNE
-            0xF0, // BEQ
-        }))
-    {
-        word dest = address + 2 + (int8_t)record.Opcodes[1];
-        Disassemble(dest, true);
-    }
-
-    address += record.Definition->ByteCount;
-    Disassemble(address);
+    DiscoverInstructions(Emu, InstructionMap, address, jumped);
 }
 
 void Debugger::PrintDisassembly()
 {
-    word entrypoint = Emu->ReadWord(0xFFFC, false);
-    word interrupt = Emu->ReadWord(0xFFFE, false);
+    word entrypoint = Emu->PeekWord(0xFFFC);
+    word interrupt = Emu->PeekWord(0xFFFE);
 
     // InstructionRecord * ptr = FirstInstruction;
     // while (ptr) {
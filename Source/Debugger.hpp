@@ -3,6 +3,7 @@
 
 #include <Config.hpp>
 #include <Disassembly.hpp>
+#include <Types/Snapshot.hpp>
 
 #include <string>
 #include <map>
@@ -128,6 +129,9 @@ public:
 
     // void DrawDisassembly();
 
+    // Taken at the start of every Render
+    MachineSnapshot State;
+
     void DrawRegisters();
 
     void DrawRAM();
@@ -1,5 +1,6 @@
 #include "Disassembly.hpp"
 #include "Emulator.hpp"
+#include "Utility.hpp"
 
 #include <fmt/format.h>
 
@@ -17,7 +18,7 @@ static const InstructionDefinition INSTRUCTION_DEFINITIONS[] = {
     { 1, "ASL A" },
     { 1, "E$0B" },
     { 1, "E$0C" },
-    { 1, "ORA" },
+    { 3, "ORA  {1:02X}{0:02X}" },
     { 2, "ASL  {0:02X}" },
     { 1, "E$0F" },
     { 2, "BPL  {2:04X}" },
@@ -61,7 +62,7 @@ static const InstructionDefinition INSTRUCTION_DEFINITIONS[] = {
     { 2, "ROL  {0:02X},X" },
     { 1, "E$37" },
     { 1, "SEC" },
-    { 2, "AND  {0:02X},Y" },
+    { 3, "AND  {1:02X}{0:02X},Y" },
     { 1, "E$3A" },
     { 1, "E$3B" },
     { 1, "E$3C" },
@@ -265,15 +266,15 @@ static const InstructionDefinition INSTRUCTION_DEFINITIONS[] = {
 InstructionRecord::InstructionRecord(Emulator * emu, word address)
     : Address(address)
 {
-    Opcodes[0] = emu->ReadByte(address, false);
+    Opcodes[0] = emu->Peek(address);
     Definition = &INSTRUCTION_DEFINITIONS[Opcodes[0]];
 
     if (Definition->ByteCount > 1) {
-        Opcodes[1] = emu->ReadByte(address + 1, false);
+        Opcodes[1] = emu->Peek(address + 1);
     }
     
     if (Definition->ByteCount > 2) {
-        Opcodes[2] = emu->ReadByte(address + 2, false);
+        Opcodes[2] = emu->Peek(address + 2);
     }
 }
 
@@ -298,4 +299,102 @@ const char * InstructionRecord::ToString()
     fmt::format_to(it, fmt::runtime(Definition->Format), Opcodes[1], Opcodes[2], Address + 2 + (int8_t)Opcodes[1]);
 
     return buffer;
-}
\ No newline at end of file
+}
+
+void DiscoverInstructions(Emulator * emu, std::map<word, InstructionRecord>& instructions, word address, bool jumped /*= false*/)
+{
+    // printf("Disassembling %04X\n", address);
+
+    auto it = instructions.find(address);
+    if (it != instructions.end()) {
+        if (jumped) {
+            it->second.JumpDestination = true;
+        }
+        
+        return;
+    }
+
+    // InstructionRecord record(emu, address);
+
+    // Suck it std::map
+    auto [newIt, _] = instructions.emplace(address, InstructionRecord(emu, address));
+    
+    InstructionRecord& record = newIt->second;
+    
+    if (jumped) {
+        record.JumpDestination = true;
+    }
+
+    // if (!FirstInstruction) {
+    //     FirstInstruction = record;
+    //     goto next; // fuck it
+    // }
+
+    // if (FirstInstruction->Address > address) {
+    //     record.Next = FirstInstruction;
+    //     FirstInstruction->Prev = record;
+    //     FirstInstruction = record;
+    //     goto next;
+    // }
+
+    // ptr = FirstInstruction;
+    // while (ptr->Next) {
+    //     if (ptr->Address < address) {
+    //         if (ptr->Next->Address > address) {
+    //             record.Next = ptr->Next;
+    //             record.Prev = ptr;
+    //             ptr->Next = record;
+    //             goto next;
+    //         }
+    //     }
+
+    //     ptr = ptr->Next;
+    // }
+
+    // ptr->Next = record;
+    // record.Prev = ptr;
+
+// next:
+
+    if (record.Opcodes[0] == 0x40 || // RTI
+        record.Opcodes[0] == 0x60) { // RTS
+        return;
+    }
+    else if (record.Opcodes[0] == 0x00) { // BRK
+        address = emu->PeekWord(0xFFFE);
+        DiscoverInstructions(emu, instructions, address, true);
+        return;
+    }
+    else if (record.Opcodes[0] == 0x4C) { // JMP Absolute
+        address = (record.Opcodes[2] << 8) | record.Opcodes[1];
+        DiscoverInstructions(emu, instructions, address, true);
+        return;
+    }
+    else if (record.Opcodes[0] == 0x6C) { // JMP (Absolute)
+        address = (record.Opcodes[2] << 8) | record.Opcodes[1];
+        address = emu->PeekWord(address);
+        DiscoverInstructions(emu, instructions, address, true);
+        return;
+    }
+    else if (record.Opcodes[0] == 0x20) { // JSR Absolute
+        word dest = (record.Opcodes[2] << 8) | record.Opcodes[1];
+        DiscoverInstructions(emu, instructions, dest, true);
+    }
+    else if (IsIn(record.Opcodes[0], {
+            0x10, // BPL
+            0x30, // BMI
+            0x50, // BVC
+            0x70, // BVS
+            0x90, // BCC
+            0xB0, // BCS
+            0xD0, // BNE
+            0xF0, // BEQ
+        }))
+    {
+        word dest = address + 2 + (int8_t)record.Opcodes[1];
+        DiscoverInstructions(emu, instructions, dest, true);
+    }
+
+    address += record.Definition->ByteCount;
+    DiscoverInstructions(emu, instructions, address);
+}
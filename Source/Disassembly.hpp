@@ -3,6 +3,8 @@
 
 #include <Config.hpp>
 
+#include <map>
+
 class Emulator;
 
 struct InstructionDefinition
@@ -35,4 +37,7 @@ struct InstructionRecord
 
 }; // struct InstructionRecord
 
+// Follows the control flow from address, adding every instruction it reaches to instructions
+void DiscoverInstructions(Emulator * emu, std::map<word, InstructionRecord>& instructions, word address, bool jumped = false);
+
 #endif // DISASSEMBLY_HPP
\ No newline at end of file
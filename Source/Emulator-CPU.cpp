@@ -1,674 +1,1285 @@
 #include "Emulator.hpp"
+#include "Utility.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
+#include <utility>
 
 #include <fmt/format.h>
 
-void Emulator::TickCPU()
+// N and Z are evaluated lazily, see ReadSR
+#define SET_NZ(VALUE) \
+    FlagResultN = (VALUE); \
+    FlagResultZ = (VALUE);
+
+// Decimal mode ADC/SBC, as done by the NMOS 6502
+// Indexed by carry, A and the operand, giving the result and the flags in SR layout
+struct DecimalResult
 {
-    if (WSYNC) {
-        CPUCycleCount += 1;
-        return;
+    byte Result;
+    byte Flags;
+};
+
+constexpr byte DECIMAL_FLAG_C = 0x01;
+constexpr byte DECIMAL_FLAG_Z = 0x02;
+constexpr byte DECIMAL_FLAG_V = 0x40;
+constexpr byte DECIMAL_FLAG_N = 0x80;
+
+constexpr unsigned DecimalIndex(byte a, byte m, bool c)
+{
+    return (c << 16) | (a << 8) | m;
+}
+
+// Fixed up a nibble at a time, Z comes from the binary sum and N and V from the sum before the high nibble is fixed up
+constexpr DecimalResult DecimalAdd(byte a, byte m, bool c)
+{
+    int low = (a & 0x0F) + (m & 0x0F) + c;
+    if (low >= 0x0A) {
+        low = ((low + 0x06) & 0x0F) + 0x10;
     }
 
-    uint16_t checkAddress = (PC & ADDRESS_MASK);
-    if (Debug && Debug->Breakpoint == PC) {
-        IsPlaying = false;
-        IsDrawing = false;
-        Debug->Breakpoint = -1;
+    int sum = (a & 0xF0) + (m & 0xF0) + low;
+    int signedSum = (int8_t)(a & 0xF0) + (int8_t)(m & 0xF0) + low;
+
+    byte flags = 0;
+    if (sum & 0x80) {
+        flags |= DECIMAL_FLAG_N;
+    }
+    if (signedSum < -128 || signedSum > 127) {
+        flags |= DECIMAL_FLAG_V;
+    }
+    if (((a + m + c) & 0xFF) == 0) {
+        flags |= DECIMAL_FLAG_Z;
+    }
+
+    if (sum >= 0xA0) {
+        sum += 0x60;
+    }
+    if (sum >= 0x100) {
+        flags |= DECIMAL_FLAG_C;
+    }
+
+    return { (byte)(sum & 0xFF), flags };
+}
+
+// Fixed up a nibble at a time, all the flags come from the binary difference
+constexpr DecimalResult DecimalSubtract(byte a, byte m, bool c)
+{
+    int low = (a & 0x0F) - (m & 0x0F) + c - 1;
+    if (low < 0) {
+        low = ((low - 0x06) & 0x0F) - 0x10;
+    }
+
+    int difference = (a & 0xF0) - (m & 0xF0) + low;
+    if (difference < 0) {
+        difference -= 0x60;
     }
 
-    OperationCode opcode = { ._raw = NextByte() };
+    int binary = a - m - (c ? 0 : 1);
 
-    #define SET_NZ(VALUE) \
-        N = (((VALUE) & 0x80) > 0); \
-        Z = ((VALUE) == 0);
+    byte flags = 0;
+    if (binary & 0x80) {
+        flags |= DECIMAL_FLAG_N;
+    }
+    if ((a ^ m) & (a ^ binary) & 0x80) {
+        flags |= DECIMAL_FLAG_V;
+    }
+    if ((binary & 0xFF) == 0) {
+        flags |= DECIMAL_FLAG_Z;
+    }
+    if (binary >= 0) {
+        flags |= DECIMAL_FLAG_C;
+    }
+
+    return { (byte)(difference & 0xFF), flags };
+}
+
+typedef std::array<DecimalResult, 0x20000> DecimalTable;
+
+template <DecimalResult (*Operation)(byte, byte, bool)>
+constexpr DecimalTable MakeDecimalTable()
+{
+    DecimalTable table = {};
+    for (unsigned c = 0; c < 2; ++c) {
+        for (unsigned a = 0; a < 0x100; ++a) {
+            for (unsigned m = 0; m < 0x100; ++m) {
+                table[DecimalIndex(a, m, c)] = Operation(a, m, c);
+            }
+        }
+    }
+    return table;
+}
+
+static constexpr DecimalTable DECIMAL_ADC_TABLE = MakeDecimalTable<DecimalAdd>();
+static constexpr DecimalTable DECIMAL_SBC_TABLE = MakeDecimalTable<DecimalSubtract>();
+
+constexpr unsigned FromBCD(unsigned value)
+{
+    return ((value >> 4) * 10) + (value & 0x0F);
+}
+
+constexpr unsigned ToBCD(unsigned value)
+{
+    return ((value / 10) << 4) | (value % 10);
+}
+
+// Every pair of valid BCD operands has to match plain decimal arithmetic, and Z the binary result for all of them
+constexpr bool ValidateDecimalTables()
+{
+    for (unsigned c = 0; c < 2; ++c) {
+        for (unsigned a = 0; a < 100; ++a) {
+            for (unsigned m = 0; m < 100; ++m) {
+                const DecimalResult& add = DECIMAL_ADC_TABLE[DecimalIndex(ToBCD(a), ToBCD(m), c)];
+                unsigned sum = a + m + c;
+                if (add.Result != ToBCD(sum % 100) || bool(add.Flags & DECIMAL_FLAG_C) != (sum >= 100)) {
+                    return false;
+                }
+
+                const DecimalResult& subtract = DECIMAL_SBC_TABLE[DecimalIndex(ToBCD(a), ToBCD(m), c)];
+                int difference = int(a) - int(m) - (c ? 0 : 1);
+                if (subtract.Result != ToBCD((difference + 100) % 100) || bool(subtract.Flags & DECIMAL_FLAG_C) != (difference >= 0)) {
+                    return false;
+                }
+            }
+        }
+
+        for (unsigned a = 0; a < 0x100; ++a) {
+            for (unsigned m = 0; m < 0x100; ++m) {
+                bool addZero = (((a + m + c) & 0xFF) == 0);
+                bool subtractZero = (((a - m - (c ? 0 : 1)) & 0xFF) == 0);
+                if (bool(DECIMAL_ADC_TABLE[DecimalIndex(a, m, c)].Flags & DECIMAL_FLAG_Z) != addZero
+                    || bool(DECIMAL_SBC_TABLE[DecimalIndex(a, m, c)].Flags & DECIMAL_FLAG_Z) != subtractZero) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+static_assert(ValidateDecimalTables(), "Decimal mode tables don't match decimal arithmetic");
+
+// Flags come out of the tables already computed, so N and Z have to be set so that ReadSR reproduces them
+#define SET_DECIMAL_FLAGS(FLAGS) \
+    C = ((FLAGS) & DECIMAL_FLAG_C) ? 1 : 0; \
+    V = ((FLAGS) & DECIMAL_FLAG_V) ? 1 : 0; \
+    FlagResultN = ((FLAGS) & DECIMAL_FLAG_N); \
+    FlagResultZ = ((FLAGS) & DECIMAL_FLAG_Z) ? 0 : 1;
+
+template <byte Opcode>
+void Emulator::Execute()
+{
+    constexpr unsigned length = OperandLength(Opcode);
+
+    word operand = 0;
+    if constexpr (length == 1) {
+        operand = NextByte();
+    }
+    if constexpr (length == 2) {
+        operand = NextWord();
+    }
+
+    Operate<Opcode>(operand);
+}
+
+template <byte Opcode>
+void Emulator::Operate(word operand)
+{
+    constexpr unsigned group = OpcodeGroup(Opcode);
+    constexpr unsigned mode = OpcodeMode(Opcode);
+    constexpr unsigned inst = OpcodeInst(Opcode);
+
+    constexpr bool immediate = !IsImplied(Opcode) && (group == 0b01 ? (mode == 0b010) : (mode == 0b000));
 
     byte data;
     word address;
     word result; // The 16-bit result of 8-bit math, used to look for overflows
-    byte small_result; // The 8-bit result of 8-bit math
-
-    bool found = true;
-
-    switch (opcode._raw) {
-    // BRK (Break Command, Software Interrupt)
-    case 0x00:
-        I = 1;
-        PushWord(PC + 2);
-        PushByte(SR);
-        PC = ReadWord(0xFFFE);
-        CPUCycleCount += 1;
-        break;
 
-    // JSR (Jump to Subroutine)
-    case 0x20:
-        PushWord(PC + 1);
-        PC = NextWord();
-        CPUCycleCount += 1;
-        break;
-
-    // RTI (Return from Interrupt)
-    case 0x40:
-        SR = PopByte();
-        PC = PopWord();
-        I = 0;
-        CPUCycleCount += 2;
-        break;
-
-    // RTS (Return from Subroutine)
-    case 0x60:
-        PC = PopWord() + 1;
-        CPUCycleCount += 3;
-        break;
-
-    // PHP (Push Processor Status on Stack)
-    case 0x08:
-        PushByte(SR);
-        CPUCycleCount += 1;
-        break;
+    // Immediate operands were already read along with the instruction
+    auto read = [this, operand](word address) -> byte {
+        if constexpr (immediate) {
+            return operand;
+        }
+        else {
+            return ReadByte(address);
+        }
+    };
+
+    if constexpr (IsImplied(Opcode)) {
+        // BRK (Break Command, Software Interrupt)
+        if constexpr (Opcode == 0x00) {
+            I = 1;
+            PushWord(PC + 2);
+            PushByte(ReadSR());
+            PC = ReadWord(0xFFFE);
+            CPUCycleCount += 1;
+        }
 
-    // PLP (Pull Processor Status from Stack)
-    case 0x28:
-        SR = PopByte();
-        CPUCycleCount += 2;
-        break;
+        // JSR (Jump to Subroutine)
+        if constexpr (Opcode == 0x20) {
+            PushWord(PC - 1);
+            PC = operand;
+            CPUCycleCount += 1;
+        }
 
-    // PHA (Push Accumulator on Stack)
-    case 0x48:
-        PushByte(A);
-        CPUCycleCount += 1;
-        break;
-
-    // PLA (Pull Accumulator from Stack)
-    case 0x68:
-        A = PopByte();
-        CPUCycleCount += 2;
-        break;
-
-    // DEY (Decrement Y by One)
-    case 0x88:
-        Y -= 1;
-        SET_NZ(Y);
-        CPUCycleCount += 1;
-        break;
+        // RTI (Return from Interrupt)
+        if constexpr (Opcode == 0x40) {
+            WriteSR(PopByte());
+            PC = PopWord();
+            I = 0;
+            CPUCycleCount += 2;
+        }
 
-    // TAY (Transfer Accumulator to Y)
-    case 0xA8:
-        Y = A;
-        SET_NZ(Y);
-        CPUCycleCount += 1;
-        break;
+        // RTS (Return from Subroutine)
+        if constexpr (Opcode == 0x60) {
+            PC = PopWord() + 1;
+            CPUCycleCount += 3;
+        }
 
-    // INY (Increment Y by One)
-    case 0xC8:
-        Y += 1;
-        SET_NZ(Y);
-        CPUCycleCount += 1;
-        break;
+        // PHP (Push Processor Status on Stack)
+        if constexpr (Opcode == 0x08) {
+            PushByte(ReadSR());
+            CPUCycleCount += 1;
+        }
 
-    // INX (Increment X by One)
-    case 0xE8:
-        X += 1;
-        SET_NZ(X);
-        CPUCycleCount += 1;
-        break;
+        // PLP (Pull Processor Status from Stack)
+        if constexpr (Opcode == 0x28) {
+            WriteSR(PopByte());
+            CPUCycleCount += 2;
+        }
 
-    // CLC (Clear Carry Flag)
-    case 0x18:
-        C = 0;
-        CPUCycleCount += 1;
-        break;
+        // PHA (Push Accumulator on Stack)
+        if constexpr (Opcode == 0x48) {
+            PushByte(A);
+            CPUCycleCount += 1;
+        }
 
-    // SEC (Set Carry Flag)
-    case 0x38:
-        C = 1;
-        CPUCycleCount += 1;
-        break;
+        // PLA (Pull Accumulator from Stack)
+        if constexpr (Opcode == 0x68) {
+            A = PopByte();
+            CPUCycleCount += 2;
+        }
 
-    // CLI (Clear Disable Interrupt Flag)
-    case 0x58:
-        I = 0;
-        CPUCycleCount += 1;
-        break;
+        // DEY (Decrement Y by One)
+        if constexpr (Opcode == 0x88) {
+            Y -= 1;
+            SET_NZ(Y);
+            CPUCycleCount += 1;
+        }
 
-    // SEI (Set Disable Interrupt Flag)
-    case 0x78:
-        I = 1;
-        CPUCycleCount += 1;
-        break;
+        // TAY (Transfer Accumulator to Y)
+        if constexpr (Opcode == 0xA8) {
+            Y = A;
+            SET_NZ(Y);
+            CPUCycleCount += 1;
+        }
 
-    // TYA (Transfer Y To Accumulator)
-    case 0x98:
-        A = Y;
-        SET_NZ(A);
-        CPUCycleCount += 1;
-        break;
+        // INY (Increment Y by One)
+        if constexpr (Opcode == 0xC8) {
+            Y += 1;
+            SET_NZ(Y);
+            CPUCycleCount += 1;
+        }
 
-    // CLV (Clear Overflow Flag)
-    case 0xB8:
-        V = 0;
-        CPUCycleCount += 1;
-        break;
+        // INX (Increment X by One)
+        if constexpr (Opcode == 0xE8) {
+            X += 1;
+            SET_NZ(X);
+            CPUCycleCount += 1;
+        }
 
-    // CLD (Clear Decimal Mode Flag)
-    case 0xD8:
-        D = 0;
-        CPUCycleCount += 1;
-        break;
+        // CLC (Clear Carry Flag)
+        if constexpr (Opcode == 0x18) {
+            C = 0;
+            CPUCycleCount += 1;
+        }
 
-    // SED (Set Decimal Mode Flag)
-    case 0xF8:
-        D = 1;
-        CPUCycleCount += 1;
-        break;
+        // SEC (Set Carry Flag)
+        if constexpr (Opcode == 0x38) {
+            C = 1;
+            CPUCycleCount += 1;
+        }
 
-    // TXA (Transfer X to Accumulator)
-    case 0x8A:
-        A = X;
-        SET_NZ(A);
-        CPUCycleCount += 1;
-        break;
+        // CLI (Clear Disable Interrupt Flag)
+        if constexpr (Opcode == 0x58) {
+            I = 0;
+            CPUCycleCount += 1;
+        }
 
-    // TXS (Transfer X to Stack Pointer)
-    case 0x9A:
-        SP = X;
-        CPUCycleCount += 1;
-        break;
+        // SEI (Set Disable Interrupt Flag)
+        if constexpr (Opcode == 0x78) {
+            I = 1;
+            CPUCycleCount += 1;
+        }
 
-    // TAX (Transfer Accumulator to X)
-    case 0xAA:
-        X = A;
-        SET_NZ(X);
-        CPUCycleCount += 1;
-        break;
+        // TYA (Transfer Y To Accumulator)
+        if constexpr (Opcode == 0x98) {
+            A = Y;
+            SET_NZ(A);
+            CPUCycleCount += 1;
+        }
 
-    // TSX (Transfer Stack Pointer to X)
-    case 0xBA:
-        X = SP;
-        SET_NZ(X);
-        CPUCycleCount += 1;
-        break;
+        // CLV (Clear Overflow Flag)
+        if constexpr (Opcode == 0xB8) {
+            V = 0;
+            CPUCycleCount += 1;
+        }
 
-    // DEX (Decrement Register X by One)
-    case 0xCA:
-        X -= 1;
-        SET_NZ(X);
-        CPUCycleCount += 1;
-        break;
+        // CLD (Clear Decimal Mode Flag)
+        if constexpr (Opcode == 0xD8) {
+            D = 0;
+            CPUCycleCount += 1;
+        }
 
-    // NOP (No Operation)
-    case 0xEA: // Get in the game
-        CPUCycleCount += 1;
-        break;
+        // SED (Set Decimal Mode Flag)
+        if constexpr (Opcode == 0xF8) {
+            D = 1;
+            CPUCycleCount += 1;
+        }
 
-    default:
-        found = false;
-        break;
-    }
+        // TXA (Transfer X to Accumulator)
+        if constexpr (Opcode == 0x8A) {
+            A = X;
+            SET_NZ(A);
+            CPUCycleCount += 1;
+        }
 
-    if (!found) {
-        // Branch Instructions
-        if (opcode.mode == 0b100 && opcode.group == 0b00) {
+        // TXS (Transfer X to Stack Pointer)
+        if constexpr (Opcode == 0x9A) {
+            SP = X;
+            CPUCycleCount += 1;
+        }
 
-            // $10: BPL (Branch on Result Plus)
-            // $30: BMI (Branch on Result Minus)
-            // $50: BVC (Branch on Overflow Clear)
-            // $70: BVS (Branch on Overflow Set)
-            // $90: BCC (Branch on Carry Clear)
-            // $B0: BCS (Branch on Carry Set)
-            // $D0: BNE (Branch on Result Not Zero)
-            // $F0: BEQ (Branch on Result Zero)
+        // TAX (Transfer Accumulator to X)
+        if constexpr (Opcode == 0xAA) {
+            X = A;
+            SET_NZ(X);
+            CPUCycleCount += 1;
+        }
 
-            byte check[] = { N, V, C, Z };
+        // TSX (Transfer Stack Pointer to X)
+        if constexpr (Opcode == 0xBA) {
+            X = SP;
+            SET_NZ(X);
+            CPUCycleCount += 1;
+        }
 
-            int8_t offset = (int8_t)NextByte();
+        // DEX (Decrement Register X by One)
+        if constexpr (Opcode == 0xCA) {
+            X -= 1;
+            SET_NZ(X);
+            CPUCycleCount += 1;
+        }
 
-            if (check[opcode.flag] == opcode.test) {
-                PC += offset;
-                CPUCycleCount += 1;
-            }
+        // NOP (No Operation)
+        if constexpr (Opcode == 0xEA) { // Get in the game
+            CPUCycleCount += 1;
+        }
+    }
+    // Branch Instructions
+    else if constexpr (mode == 0b100 && group == 0b00) {
+
+        // $10: BPL (Branch on Result Plus)
+        // $30: BMI (Branch on Result Minus)
+        // $50: BVC (Branch on Overflow Clear)
+        // $70: BVS (Branch on Overflow Set)
+        // $90: BCC (Branch on Carry Clear)
+        // $B0: BCS (Branch on Carry Set)
+        // $D0: BNE (Branch on Result Not Zero)
+        // $F0: BEQ (Branch on Result Zero)
+
+        constexpr unsigned flag = OpcodeFlag(Opcode);
+        constexpr unsigned test = OpcodeTest(Opcode);
+
+        byte check;
+        if constexpr (flag == 0) check = (FlagResultN >> 7);
+        if constexpr (flag == 1) check = V;
+        if constexpr (flag == 2) check = C;
+        if constexpr (flag == 3) check = (FlagResultZ == 0);
+
+        int8_t offset = (int8_t)operand;
+
+        if (check == test) {
+            PC += offset;
+            CPUCycleCount += 1;
         }
-        else if (opcode.group == 0b01) {
+    }
+    else if constexpr (group == 0b01) {
 
-            switch (opcode.mode) {
-            // (Zero Page,X)
-            case 0b000:
-                address = ReadWord(0x0000 + (byte)(NextByte() + X));
-                CPUCycleCount += 1;
-                break;
+        // (Zero Page,X)
+        if constexpr (mode == 0b000) {
+            address = ReadWord(0x0000 + (byte)(operand + X));
+            CPUCycleCount += 1;
+        }
 
-            // Zero Page
-            case 0b001:
-                address = 0x0000 + NextByte();
-                break;
+        // Zero Page
+        if constexpr (mode == 0b001) {
+            address = 0x0000 + operand;
+        }
 
-            // #Immediate
-            case 0b010:
-                address = PC;
-                PC += 1;
-                break;
+        // #Immediate
+        if constexpr (mode == 0b010) {
+            address = PC - 1;
+        }
 
-            // Absolute
-            case 0b011:
-                address = NextWord();
-                break;
+        // Absolute
+        if constexpr (mode == 0b011) {
+            address = operand;
+        }
 
-            // (Zero Page),Y
-            case 0b100:
-                address = ReadWord(NextByte()) + Y;
-                break;
+        // (Zero Page),Y
+        if constexpr (mode == 0b100) {
+            address = ReadWord(operand) + Y;
+        }
 
-            // Zero Page,X
-            case 0b101:
-                address = 0x0000 + (byte)(NextByte() + X);
-                CPUCycleCount += 1;
-                break;
+        // Zero Page,X
+        if constexpr (mode == 0b101) {
+            address = 0x0000 + (byte)(operand + X);
+            CPUCycleCount += 1;
+        }
 
-            // Absolute,Y
-            case 0b110:
-                address = NextWord() + Y;
-                break;
+        // Absolute,Y
+        if constexpr (mode == 0b110) {
+            address = operand + Y;
+        }
 
-            // Absolute,X
-            case 0b111:
-                address = NextWord() + X;
-                break;
-            }
+        // Absolute,X
+        if constexpr (mode == 0b111) {
+            address = operand + X;
+        }
 
-            switch (opcode.inst) {
-            // ORA (Bitwise OR Memory with Accumulator)
-            // $09: #Immediate
-            // $0D: Absolute
-            // $1D: Absolute,X
-            // $19: Absolute,Y
-            // $05: Zero Page
-            // $15: Zero Page,X
-            // $01: (Zero Page,X)
-            // $11: (Zero Page),Y
-            case 0b000:
-                A |= ReadByte(address);
-                SET_NZ(A);
-                break;
+        // ORA (Bitwise OR Memory with Accumulator)
+        // $09: #Immediate
+        // $0D: Absolute
+        // $1D: Absolute,X
+        // $19: Absolute,Y
+        // $05: Zero Page
+        // $15: Zero Page,X
+        // $01: (Zero Page,X)
+        // $11: (Zero Page),Y
+        if constexpr (inst == 0b000) {
+            A |= read(address);
+            SET_NZ(A);
+        }
 
-            // AND (Bitwise AND Memory with Accumulator)
-            // $29: #Immediate
-            // $2D: Absolute
-            // $3D: Absolute,X
-            // $39: Absolute,Y
-            // $25: Zero Page
-            // $35: Zero Page,X
-            // $21: (Zero Page,X)
-            // $31: (Zero Page),Y
-            case 0b001:
-                A &= ReadByte(address);
-                SET_NZ(A);
-                break;
+        // AND (Bitwise AND Memory with Accumulator)
+        // $29: #Immediate
+        // $2D: Absolute
+        // $3D: Absolute,X
+        // $39: Absolute,Y
+        // $25: Zero Page
+        // $35: Zero Page,X
+        // $21: (Zero Page,X)
+        // $31: (Zero Page),Y
+        if constexpr (inst == 0b001) {
+            A &= read(address);
+            SET_NZ(A);
+        }
 
-            // EOR (Bitwise XOR Memory with Accumulator)
-            // $49: #Immediate
-            // $4D: Absolute
-            // $5D: Absolute,X
-            // $59: Absolute,Y
-            // $45: Zero Page
-            // $55: Zero Page,X
-            // $41: (Zero Page,X)
-            // $51: (Zero Page),Y
-            case 0b010:
-                A ^= ReadByte(address);
-                SET_NZ(A);
-                break;
+        // EOR (Bitwise XOR Memory with Accumulator)
+        // $49: #Immediate
+        // $4D: Absolute
+        // $5D: Absolute,X
+        // $59: Absolute,Y
+        // $45: Zero Page
+        // $55: Zero Page,X
+        // $41: (Zero Page,X)
+        // $51: (Zero Page),Y
+        if constexpr (inst == 0b010) {
+            A ^= read(address);
+            SET_NZ(A);
+        }
 
-            // ADC (Add Memory to Accumulator with Carry)
-            // $69: #Immediate
-            // $6D: Absolute
-            // $7D: Absolute,X
-            // $79: Absolute,Y
-            // $65: Zero Page
-            // $75: Zero Page,X
-            // $61: (Zero Page,X)
-            // $71: (Zero Page),Y
-            case 0b011:
-                data = ReadByte(address);
+        // ADC (Add Memory to Accumulator with Carry)
+        // $69: #Immediate
+        // $6D: Absolute
+        // $7D: Absolute,X
+        // $79: Absolute,Y
+        // $65: Zero Page
+        // $75: Zero Page,X
+        // $61: (Zero Page,X)
+        // $71: (Zero Page),Y
+        if constexpr (inst == 0b011) {
+            data = read(address);
+            if (D) {
+                const DecimalResult& decimal = DECIMAL_ADC_TABLE[DecimalIndex(A, data, C)];
+                A = decimal.Result;
+                SET_DECIMAL_FLAGS(decimal.Flags);
+            }
+            else {
                 result = A + data + C;
                 C = (result & 0xFF00);
                 A = (result & 0xFF);
                 V = ((A ^ data) & (A ^ result) & 0x80); // wtf // We overflowing boiiiiii // #help
                 SET_NZ(A);
-                break;
+            }
+        }
 
-            // STA (Store Accumulator into Memory)
-            // $8D: Absolute
-            // $9D: Absolute,X
-            // $99: Absolute,Y
-            // $85: Zero Page
-            // $95: Zero Page,X
-            // $81: (Zero Page,X)
-            // $91: (Zero Page),Y
-            case 0b100:
-                WriteByte(address, A);
-                break;
+        // STA (Store Accumulator into Memory)
+        // $8D: Absolute
+        // $9D: Absolute,X
+        // $99: Absolute,Y
+        // $85: Zero Page
+        // $95: Zero Page,X
+        // $81: (Zero Page,X)
+        // $91: (Zero Page),Y
+        if constexpr (inst == 0b100) {
+            WriteByte(address, A);
+        }
 
-            // LDA (Load Accumulator from Memory)
-            // $A9: #Immediate
-            // $AD: Absolute
-            // $BD: Absolute,X
-            // $B9: Absolute,Y
-            // $A5: Zero Page
-            // $B5: Zero Page,X
-            // $A1: (Zero Page,X)
-            // $B1: (Zero Page),Y
-            case 0b101:
-                A = ReadByte(address);
-                SET_NZ(A);
-                break;
+        // LDA (Load Accumulator from Memory)
+        // $A9: #Immediate
+        // $AD: Absolute
+        // $BD: Absolute,X
+        // $B9: Absolute,Y
+        // $A5: Zero Page
+        // $B5: Zero Page,X
+        // $A1: (Zero Page,X)
+        // $B1: (Zero Page),Y
+        if constexpr (inst == 0b101) {
+            A = read(address);
+            SET_NZ(A);
+        }
 
-            // CMP (Compare Memory with Accumulator)
-            // $C9: #Immediate
-            // $CD: Absolute
-            // $DD: Absolute,X
-            // $D9: Absolute,Y
-            // $C5: Zero Page
-            // $D5: Zero Page,X
-            // $C1: (Zero Page,X)
-            // $D1: (Zero Page),Y
-            case 0b110:
-                result = A - ReadByte(address);
-                C = !(result & 0xFF00);
-                SET_NZ(result & 0xFF00);
-                break;
+        // CMP (Compare Memory with Accumulator)
+        // $C9: #Immediate
+        // $CD: Absolute
+        // $DD: Absolute,X
+        // $D9: Absolute,Y
+        // $C5: Zero Page
+        // $D5: Zero Page,X
+        // $C1: (Zero Page,X)
+        // $D1: (Zero Page),Y
+        if constexpr (inst == 0b110) {
+            result = A - read(address);
+            C = !(result & 0xFF00);
+            SET_NZ(result & 0xFF00);
+        }
 
-            // SBC (Subtract Memory from Accumulator with Borrow)
-            /*
-            This instruction subtracts the value of memory and borrow from the value of the accumulator, using two's complement arithmetic, and stores the result in the accumulator. 
-            Borrow is defined as the carry flag complemented; therefore, a resultant carry flag indicates that a borrow has not occurred.
-            This instruction affects the accumulator. The carry flag is set if the result is greater than or equal to 0. The carry flag is reset when the result is less than 0, indicating a borrow. 
-            The over­flow flag is set when the result exceeds +127 or -127, otherwise it is reset. The negative flag is set if the result in the accumulator has bit 7 on, otherwise it is reset. 
-            The Z flag is set if the result in the accumulator is 0, otherwise it is reset.
-            Note on the MOS 6502:
-            In decimal mode, the N, V and Z flags are not consistent with the decimal result.*/
-            // $E9: #Immediate
-            // $ED: Absolute
-            // $FD: Absolute,X
-            // $F9: Absolute,Y
-            // $E5: Zero Page
-            // $F5: Zero Page,X
-            // $E1: (Zero Page,X)
-            // $F1: (Zero Page),Y
-            //TODO: Decimal Mode
-            case 0b111:
-                data = ReadByte(address);
+        // SBC (Subtract Memory from Accumulator with Borrow)
+        /*
+        This instruction subtracts the value of memory and borrow from the value of the accumulator, using two's complement arithmetic, and stores the result in the accumulator.
+        Borrow is defined as the carry flag complemented; therefore, a resultant carry flag indicates that a borrow has not occurred.
+        This instruction affects the accumulator. The carry flag is set if the result is greater than or equal to 0. The carry flag is reset when the result is less than 0, indicating a borrow.
+        The over­flow flag is set when the result exceeds +127 or -127, otherwise it is reset. The negative flag is set if the result in the accumulator has bit 7 on, otherwise it is reset.
+        The Z flag is set if the result in the accumulator is 0, otherwise it is reset.
+        Note on the MOS 6502:
+        In decimal mode, the N, V and Z flags are not consistent with the decimal result.*/
+        // $E9: #Immediate
+        // $ED: Absolute
+        // $FD: Absolute,X
+        // $F9: Absolute,Y
+        // $E5: Zero Page
+        // $F5: Zero Page,X
+        // $E1: (Zero Page,X)
+        // $F1: (Zero Page),Y
+        if constexpr (inst == 0b111) {
+            data = read(address);
+            if (D) {
+                const DecimalResult& decimal = DECIMAL_SBC_TABLE[DecimalIndex(A, data, C)];
+                A = decimal.Result;
+                SET_DECIMAL_FLAGS(decimal.Flags);
+            }
+            else {
                 result = A - data - (C ? 0 : 1);
                 V = ((A ^ data) & (A ^ result) & 0x80); // wtf
                 C = !(result & 0xFF00);
                 A = (result & 0xFF);
                 SET_NZ(A);
-                break;
             }
         }
-        else if (opcode.group == 0b10) {
+    }
+    // $x2/$xA with no Immediate/Accumulator form are jams or NOPs on the 6507
+    else if constexpr (group == 0b10 && (mode == 0b100 || mode == 0b110)) {
+    }
+    else if constexpr (group == 0b10) {
 
-            bool isA = (opcode.mode == 0b010);
-            bool isX = (opcode.inst == 0b100 || opcode.inst == 0b101);
+        constexpr bool isA = (mode == 0b010);
+        constexpr bool isX = (inst == 0b100 || inst == 0b101);
 
-            switch (opcode.mode) {
-            // #Immediate
-            case 0b000:
-                address = PC;
-                PC += 1;
-                break;
+        // #Immediate
+        if constexpr (mode == 0b000) {
+            address = PC - 1;
+        }
 
-            // Zero Page
-            case 0b001:
-                address = 0x0000 + NextByte();
-                break;
+        // Zero Page
+        if constexpr (mode == 0b001) {
+            address = 0x0000 + operand;
+        }
 
-            // Accumulator
-            case 0b010:
-                break;
+        // Accumulator
+        if constexpr (mode == 0b010) {
+        }
 
-            // Absolute
-            case 0b011:
-                address = NextWord();
-                break;
+        // Absolute
+        if constexpr (mode == 0b011) {
+            address = operand;
+        }
 
-            // Zero Page,X/Y
-            case 0b101:
-                address = 0x0000 + (byte)(NextByte() + (isX ? Y : X));
-                break;
+        // Zero Page,X/Y
+        if constexpr (mode == 0b101) {
+            address = 0x0000 + (byte)(operand + (isX ? Y : X));
+        }
 
-            // Absolute,X/Y
-            case 0b111:
-                address = NextWord() + (isX ? Y : X);
-                break;
+        // Absolute,X/Y
+        if constexpr (mode == 0b111) {
+            address = operand + (isX ? Y : X);
+        }
+
+        // ASL (Arithmetic Shift Left)
+        // $0A: Accumulator
+        // $0E: Absolute
+        // $1E: Absolute,X
+        // $06: Zero Page
+        // $16: Zero Page,X
+        if constexpr (inst == 0b000) {
+            if constexpr (isA) {
+                C = (A & 0x80);
+                A <<= 1;
+                SET_NZ(A);
             }
+            else {
+                data = read(address);
+                C = (data & 0x80);
+                data <<= 1;
+                SET_NZ(data);
+                WriteByte(address, data);
+            }
+        }
 
-            switch (opcode.inst) {
-            // ASL (Arithmetic Shift Left)
-            // $0A: Accumulator
-            // $0E: Absolute
-            // $1E: Absolute,X
-            // $06: Zero Page
-            // $16: Zero Page,X
-            case 0b000:
-                if (isA) {
-                    C = (A & 0x80);
-                    A <<= 1;
-                    SET_NZ(A);
-                }
-                else {
-                    data = ReadByte(address);
-                    C = (data & 0x80);
-                    data <<= 1;
-                    SET_NZ(data);
-                    WriteByte(address, data);
-                }
-                break;
+        // ROL (Rotate Left)
+        // $2A: Accumulator
+        // $2E: Absolute
+        // $3E: Absolute,X
+        // $26: Zero Page
+        // $36: Zero Page,X
+        if constexpr (inst == 0b001) {
+            if constexpr (isA) {
+                result = (A << 1) | C;
+                C = (result & 0x0100);
+                A = result;
+                SET_NZ(A);
+            }
+            else {
+                data = read(address);
+                result = (data << 1) | C;
+                C = (result & 0x0100);
+                data = result;
+                SET_NZ(data);
+                WriteByte(address, data);
+            }
+        }
 
-            // ROL (Rotate Left)
-            // $2A: Accumulator
-            // $2E: Absolute
-            // $3E: Absolute,X
-            // $26: Zero Page
-            // $36: Zero Page,X
-            case 0b001:
-                if (isA) {
-                    result = (A << 1) | C;
-                    C = (result & 0x0100);
-                    A = result;
-                    SET_NZ(A);
-                }
-                else {
-                    data = ReadByte(address);
-                    result = (data << 1) | C;
-                    C = (result & 0x0100);
-                    data = result;
-                    SET_NZ(data);
-                    WriteByte(address, data);
-                }
-                break;
+        // LSR (Logical Shift Right)
+        // $4A: Accumulator
+        // $4E: Absolute
+        // $5E: Absolute,X
+        // $46: Zero Page
+        // $56: Zero Page,X
+        if constexpr (inst == 0b010) {
+            if constexpr (isA) {
+                C = (A & 0x01);
+                A >>= 1;
+                SET_NZ(A);
+            }
+            else {
+                data = read(address);
+                C = (data & 0x01);
+                data >>= 1;
+                SET_NZ(data);
+                WriteByte(address, data);
+            }
+        }
 
-            // LSR (Logical Shift Right)
-            // $4A: Accumulator
-            // $4E: Absolute
-            // $5E: Absolute,X
-            // $46: Zero Page
-            // $56: Zero Page,X
-            case 0b010:
-                if (isA) {
-                    C = (A & 0x01);
-                    A >>= 1;
-                    SET_NZ(A);
-                }
-                else {
-                    data = ReadByte(address);
-                    C = (data & 0x01);
-                    data >>= 1;
-                    SET_NZ(data);
-                    WriteByte(address, data);
-                }
-                break;
+        // ROR (Rotate Right)
+        // $6A: Accumulator
+        // $6E: Absolute
+        // $7E: Absolute,X
+        // $66: Zero Page
+        // $76: Zero Page,X
+        if constexpr (inst == 0b011) {
+            if constexpr (isA) {
+                result = ((A | (C << 7)) >> 1);
+                C = (A & 0x01);
+                A = result;
+                SET_NZ(A);
+            }
+            else {
+                data = read(address);
+                result = ((data | (C << 7)) >> 1);
+                C = (data & 0x01);
+                data = result;
+                SET_NZ(data);
+            }
+        }
 
-            // ROR (Rotate Right)
-            // $6A: Accumulator
-            // $6E: Absolute
-            // $7E: Absolute,X
-            // $66: Zero Page
-            // $76: Zero Page,X
-            case 0b011:
-                if (isA) {
-                    result = ((A | (C << 7)) >> 1);
-                    C = (A & 0x01);
-                    A = result;
-                    SET_NZ(A);
-                }
-                else {
-                    data = ReadByte(address);
-                    result = ((data | (C << 7)) >> 1);
-                    C = (data & 0x01);
-                    data = result;
-                    SET_NZ(data);
-                }
-                break;
+        // STX (Store Index Register X in Memory)
+        // $8E: Absolute
+        // $86: Zero Page
+        // $96: Zero Page,Y
+        if constexpr (inst == 0b100) {
+            WriteByte(address, X);
+        }
 
-            // STX (Store Index Register X in Memory)
-            // $8E: Absolute
-            // $86: Zero Page
-            // $96: Zero Page,Y
-            case 0b100:
-                WriteByte(address, X);
-                break;
+        // LDX (Load Index Register X from Memory)
+        // $A2: #Immediate
+        // $AE: Absolute
+        // $BE: Absolute,Y
+        // $A6: Zero Page
+        // $B6: Zero Page,Y
+        if constexpr (inst == 0b101) {
+            X = read(address);
+            SET_NZ(X);
+        }
 
-            // LDX (Load Index Register X from Memory)
-            // $A2: #Immediate
-            // $AE: Absolute
-            // $BE: Absolute,Y
-            // $A6: Zero Page
-            // $B6: Zero Page,Y
-            case 0b101:
-                X = ReadByte(address);
-                SET_NZ(X);
-                break;
+        // DEC (Decrement Memory by One)
+        // $CE: Absolute
+        // $DE: Absolute,X
+        // $C6: Zero Page
+        // $D6: Zero Page,X
+        if constexpr (inst == 0b110) {
+            data = read(address) - 1;
+            SET_NZ(data);
+            WriteByte(address, data);
+        }
 
-            // DEC (Decrement Memory by One)
-            // $CE: Absolute
-            // $DE: Absolute,X
-            // $C6: Zero Page
-            // $D6: Zero Page,X
-            case 0b110:
-                data = ReadByte(address) - 1;
-                SET_NZ(data);
-                WriteByte(address, data);
-                break;
+        // INC (Increment Memory by One)
+        // $EE: Absolute
+        // $FE: Absolute,X
+        // $E6: Zero Page
+        // $F6: Zero Page,X
+        if constexpr (inst == 0b111) {
+            data = read(address) + 1;
+            SET_NZ(data);
+            WriteByte(address, data);
+        }
+    }
+    else if constexpr (group == 0b00) {
 
-            // INC (Increment Memory by One)
-            // $EE: Absolute
-            // $FE: Absolute,X
-            // $E6: Zero Page
-            // $F6: Zero Page,X
-            case 0b111:
-                data = ReadByte(address) + 1;
-                SET_NZ(data);
-                WriteByte(address, data);
-                break;
-            }
+        // #Immediate
+        if constexpr (mode == 0b000) {
+            address = PC - 1;
         }
-        else if (opcode.group == 0b00) {
 
-            switch (opcode.mode) {
-            // #Immediate
-            case 0b000:
-                address = PC;
-                PC += 1;
-                break;
+        // Zero Page
+        if constexpr (mode == 0b001) {
+            address = 0x0000 + operand;
+        }
 
-            // Zero Page
-            case 0b001:
-                address = 0x0000 + NextByte();
-                break;
+        // Absolute
+        if constexpr (mode == 0b011) {
+            address = operand;
+        }
 
-            // Absolute
-            case 0b011:
-                address = NextWord();
-                break;
+        // Zero Page,X
+        if constexpr (mode == 0b101) {
+            address = 0x0000 + (byte)(operand + X);
+        }
 
-            // Zero Page,X
-            case 0b101:
-                address = 0x0000 + (byte)(NextByte() + X);
-                break;
+        // Absolute,X
+        if constexpr (mode == 0b111) {
+            address = operand + X;
+        }
 
-            // Absolute,X
-            case 0b111:
-                address = NextWord() + X;
-                break;
+        // BIT (Test Bits in Memory with Accumulator)
+        // $2C: Absolute
+        // $24: Zero Page
+        if constexpr (inst == 0b001) {
+            data = read(address);
+            FlagResultN = data;
+            V = ((data & 0x40) > 0);
+            data &= A;
+            FlagResultZ = data;
+        }
+
+        // $4C: JMP (Jump to Address)
+        if constexpr (inst == 0b010) {
+            PC = address;
+        }
+
+        // $6C: JMP (Jump to Address Indirect)
+        if constexpr (inst == 0b011) {
+            PC = ReadWord(address);
+        }
+
+        // STY (Store Index Register Y into Memory)
+        // $8C: Absolute
+        // $84: Zero Page
+        // $94: Zero Page,X
+        if constexpr (inst == 0b100) {
+            WriteByte(address, Y);
+        }
+
+        // LDY (Load Index Register Y from Memory)
+        // $A0: #Immediate
+        // $AC: Absolute
+        // $BC: Absolute,X
+        // $A4: Zero Page
+        // $B4: Zero Page,X
+        if constexpr (inst == 0b101) {
+            Y = read(address);
+            SET_NZ(Y);
+        }
+
+        // CPY (Compare Index Register Y to Memory)
+        // $C0: #Immediate
+        // $CC: Absolute
+        // $C4: Zero Page
+        if constexpr (inst == 0b110) {
+            result = Y - read(address);
+            C = !(result & 0xFF00);
+            SET_NZ(result & 0xFF);
+        }
+
+        // CPX (Compare Index Register X to Memory)
+        // $E0: #Immediate
+        // $EC: Absolute
+        // $E4: Zero Page
+        if constexpr (inst == 0b111) {
+            result = X - read(address);
+            C = !(result & 0xFF00);
+            SET_NZ(result & 0xFF);
+        }
+    }
+
+    // Group 11 has no official instructions, they do nothing
+}
+
+template <byte Opcode>
+bool Emulator::RunInstruction(word operand, int bank)
+{
+    constexpr unsigned length = 1 + OperandLength(Opcode);
+
+    uint64_t beforeInstCycles = CPUCycleCount;
+
+    // Account for the fetch reads that recompiling saved
+    PC += length;
+    CPUCycleCount += length;
+
+    Operate<Opcode>(operand);
+
+    ++InstructionCount;
+
+    TickFramePeripherals(CPUCycleCount - beforeInstCycles);
+
+    return !(WSYNC || !IsDrawing || ROMBank != bank);
+}
+
+#define OPCODE_ROW(X, HI) \
+    X(HI##0) X(HI##1) X(HI##2) X(HI##3) X(HI##4) X(HI##5) X(HI##6) X(HI##7) \
+    X(HI##8) X(HI##9) X(HI##A) X(HI##B) X(HI##C) X(HI##D) X(HI##E) X(HI##F)
+
+#define FOR_EACH_OPCODE(X) \
+    OPCODE_ROW(X, 0) OPCODE_ROW(X, 1) OPCODE_ROW(X, 2) OPCODE_ROW(X, 3) \
+    OPCODE_ROW(X, 4) OPCODE_ROW(X, 5) OPCODE_ROW(X, 6) OPCODE_ROW(X, 7) \
+    OPCODE_ROW(X, 8) OPCODE_ROW(X, 9) OPCODE_ROW(X, A) OPCODE_ROW(X, B) \
+    OPCODE_ROW(X, C) OPCODE_ROW(X, D) OPCODE_ROW(X, E) OPCODE_ROW(X, F)
+
+// Recompiled blocks are built in their own translation unit, so every specialization has to exist here
+#define INSTANTIATE_RUN_INSTRUCTION(OP) \
+    template bool Emulator::RunInstruction<0x##OP>(word operand, int bank);
+
+FOR_EACH_OPCODE(INSTANTIATE_RUN_INSTRUCTION)
+
+typedef void (Emulator::*OpcodeHandler)();
+
+template <size_t... Opcodes>
+constexpr std::array<OpcodeHandler, 256> MakeOpcodeTable(std::index_sequence<Opcodes...>)
+{
+    return { &Emulator::Execute<Opcodes>... };
+}
+
+// Every opcode resolved to its handler at compile time
+static constexpr auto OPCODE_TABLE = MakeOpcodeTable(std::make_index_sequence<256>());
+
+typedef void (Emulator::*OperateHandler)(word operand);
+
+template <size_t... Opcodes>
+constexpr std::array<OperateHandler, 256> MakeOperateTable(std::index_sequence<Opcodes...>)
+{
+    return { &Emulator::Operate<Opcodes>... };
+}
+
+static constexpr auto OPERATE_TABLE = MakeOperateTable(std::make_index_sequence<256>());
+
+// Long straight runs are split, so a block never costs more than a few lines of decoding
+constexpr size_t MAX_BLOCK_INSTRUCTIONS = 32;
+
+DecodedBlock * Emulator::GetBlock(unsigned bank, word offset)
+{
+    auto& cache = BlockCache[bank];
+    if (cache.empty()) {
+        cache.resize(ROM_BANK_SIZE);
+    }
+
+    auto& block = cache[offset];
+    if (block) {
+        return block.get();
+    }
+
+    block = std::make_unique<DecodedBlock>();
+
+    // Don't run off the end of the slice, whatever the mapper has after it isn't known yet, or into the hotspots
+    size_t end = ((offset / Mapper->SliceSize) + 1) * Mapper->SliceSize;
+    if (offset < Mapper->HotspotStart) {
+        end = std::min(end, Mapper->HotspotStart);
+    }
+
+    while (block->Instructions.size() < MAX_BLOCK_INSTRUCTIONS) {
+        byte opcode = ROM[bank][offset];
+        unsigned length = 1 + OperandLength(opcode);
+
+        if (offset + length > end) {
+            break;
+        }
+
+        word operand = 0;
+        if (length == 2) {
+            operand = ROM[bank][offset + 1];
+        }
+        else if (length == 3) {
+            operand = ROM[bank][offset + 1] | (ROM[bank][offset + 2] << 8);
+        }
+
+        block->Instructions.push_back({
+            .Handler = OPERATE_TABLE[opcode],
+            .Operand = operand,
+            .Opcode = opcode,
+            .Length = (byte)length,
+        });
+
+        offset += length;
+
+        if (EndsBlock(opcode)) {
+            break;
+        }
+    }
+
+    if (FusionEnabled) {
+        FuseInstructions(block.get());
+    }
+
+    return block.get();
+}
+
+void Emulator::FuseInstructions(DecodedBlock * block)
+{
+    auto& instructions = block->Instructions;
+
+    // STA Zero Page or Absolute to a register that WriteTIA handles
+    auto getTIAStore = [this](const DecodedInstruction& inst) -> TIAWriteHandler {
+        if (inst.Opcode != 0x85 && inst.Opcode != 0x8D) {
+            return nullptr;
+        }
+
+        return GetTIAWrite(inst.Operand);
+    };
+
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        auto& inst = instructions[i];
+
+        if (i + 1 < instructions.size()) {
+            TIAWriteHandler store = getTIAStore(instructions[i + 1]);
+
+            if (store && (inst.Opcode == 0xA9 || inst.Opcode == 0xB1)) {
+                inst.Fusion = (inst.Opcode == 0xA9 ? FUSION_LDA_IMMEDIATE_STA_TIA : FUSION_LDA_INDIRECT_STA_TIA);
+                instructions[i + 1].TIAWrite = store;
+                ++i;
+                continue;
             }
+        }
 
-            switch (opcode.inst) {
-            // BIT (Test Bits in Memory with Accumulator)
-            // $2C: Absolute
-            // $24: Zero Page
-            case 0b001:
-                data = ReadByte(address);
-                N = ((data & 0x80) > 0);
-                V = ((data & 0x40) > 0);
-                data &= A;
-                Z = (data == 0);
-                break;
+        if (getTIAStore(inst) && (inst.Operand & ADDRESS_MASK) == ADDR_WSYNC) {
+            inst.Fusion = FUSION_STA_WSYNC;
+            inst.TIAWrite = getTIAStore(inst);
+        }
+    }
+}
 
-            // $4C: JMP (Jump to Address)
-            case 0b010:
-                PC = address;
-                break;
+void Emulator::InvalidateBlockCache()
+{
+    for (auto& cache : BlockCache) {
+        cache.clear();
+    }
 
-            // $6C: JMP (Jump to Address Indirect)
-            case 0b011:
-                PC = ReadWord(address);
-                break;
+#if defined(FREYA2600_JIT)
+    // Translated blocks belonged to the cache entries that were just freed
+    JITCodeUsed = 0;
+#endif
+}
 
-            // STY (Store Index Register Y into Memory)
-            // $8C: Absolute
-            // $84: Zero Page
-            // $94: Zero Page,X
-            case 0b100:
-                WriteByte(address, Y);
-                break;
+bool Emulator::RunBlock()
+{
+    // Only ROM is immutable, code anywhere else has to be fetched as it runs
+    const MemoryPage& page = MemoryMap[(PC & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+    if (page.Handler != PAGE_ROM || !page.Read) {
+        return false;
+    }
 
-            // LDY (Load Index Register Y from Memory)
-            // $A0: #Immediate
-            // $AC: Absolute
-            // $BC: Absolute,X
-            // $A4: Zero Page
-            // $B4: Zero Page,X
-            case 0b101:
-                Y = ReadByte(address);
-                SET_NZ(Y);
-                break;
+    // Blocks are cached by where they are in the ROM image, as mappers can put any slice of it at PC
+    size_t image = (page.Read - &ROM[0][0]) + (PC & (MEMORY_PAGE_SIZE - 1));
+    unsigned imageBank = image / ROM_BANK_SIZE;
+    word offset = image & (ROM_BANK_SIZE - 1);
 
-            // CPY (Compare Index Register Y to Memory)
-            // $C0: #Immediate
-            // $CC: Absolute
-            // $C4: Zero Page
-            case 0b110:
-                result = Y - ReadByte(address);
-                C = !(result & 0xFF00);
-                SET_NZ(result & 0xFF);
-                break;
+    if (offset >= Mapper->HotspotStart) {
+        return false;
+    }
 
-            // CPX (Compare Index Register X to Memory)
-            // $E0: #Immediate
-            // $EC: Absolute
-            // $E4: Zero Page
-            case 0b111:
-                result = X - ReadByte(address);
-                C = !(result & 0xFF00);
-                SET_NZ(result & 0xFF);
+    // Anything that changes the mapping changes ROMBank, which ends the block
+    const int bank = ROMBank;
+
+    if (!RecompiledBlocks[imageBank].empty()) {
+        RecompiledBlock function = RecompiledBlocks[imageBank][offset];
+        if (function) {
+            function(this);
+            return true;
+        }
+    }
+
+    // A block with no instructions straddles the end of the slice
+    DecodedBlock * block = GetBlock(imageBank, offset);
+    if (block->Instructions.empty()) {
+        return false;
+    }
+
+#if defined(FREYA2600_JIT)
+    // Hot blocks run as native code, which hands back to the loop below when it can't make progress
+    if (JITEnabled && RunNative(block)) {
+        return true;
+    }
+#endif
+
+    const auto& instructions = block->Instructions;
+
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        const DecodedInstruction& inst = instructions[i];
+
+        if (inst.Fusion != FUSION_NONE) {
+            if (!StepFused(&inst, bank)) {
                 break;
             }
+
+            // Both instructions of a pair have run
+            if (inst.Fusion != FUSION_STA_WSYNC) {
+                ++i;
+            }
+
+            continue;
+        }
+
+        if (!StepDecoded(inst, bank)) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool Emulator::StepFused(const DecodedInstruction * inst, int bank)
+{
+    ++FusionCounts[inst->Fusion];
+
+    const DecodedInstruction * store = inst;
+
+    // The load can still end the frame or switch banks, leaving the store for the next block
+    if (inst->Fusion != FUSION_STA_WSYNC) {
+        uint64_t beforeInstCycles = CPUCycleCount;
+
+        PC += inst->Length;
+        CPUCycleCount += inst->Length;
+
+        if (inst->Fusion == FUSION_LDA_IMMEDIATE_STA_TIA) {
+            Operate<0xA9>(inst->Operand);
+        }
+        else {
+            Operate<0xB1>(inst->Operand);
+        }
+
+        ++InstructionCount;
+
+        TickFramePeripherals(CPUCycleCount - beforeInstCycles);
+
+        if (!IsDrawing || ROMBank != bank) {
+            return false;
+        }
+
+        store = inst + 1;
+    }
+
+    // STA to the TIA, without going through WriteByte to find the register, the extra cycle is the write
+    PC += store->Length;
+    CPUCycleCount += store->Length + 1;
+
+    (this->*store->TIAWrite)(A);
+
+    ++InstructionCount;
+
+    TickFramePeripherals(store->Length + 1);
+
+    // Sit out the rest of the line here, instead of returning to DoFrame to do it
+    if (WSYNC && IsDrawing) {
+        TickFramePeripherals(SkipWSYNC());
+    }
+
+    return !(WSYNC || !IsDrawing || ROMBank != bank);
+}
+
+bool Emulator::StepDecoded(const DecodedInstruction& inst, int bank)
+{
+    uint64_t beforeInstCycles = CPUCycleCount;
+
+    // Account for the fetch reads that decoding saved
+    PC += inst.Length;
+    CPUCycleCount += inst.Length;
+
+    (this->*inst.Handler)(inst.Operand);
+
+    ++InstructionCount;
+
+    TickFramePeripherals(CPUCycleCount - beforeInstCycles);
+
+    // The rest of the block is stale once the bank switches out from under it
+    return !(WSYNC || !IsDrawing || ROMBank != bank);
+}
+
+uint64_t Emulator::SkipIdleLoop(word pc)
+{
+    // Only ROM can be checked once and trusted not to change while the loop runs
+    const MemoryPage& page = MemoryMap[(pc & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+    if (page.Handler != PAGE_ROM || !page.Read) {
+        return 0;
+    }
+
+    // The loop can run on into the next page, as long as that's the rest of the same ROM
+    size_t offset = pc & (MEMORY_PAGE_SIZE - 1);
+    if (offset + 5 > MEMORY_PAGE_SIZE) {
+        const MemoryPage& next = MemoryMap[((pc + MEMORY_PAGE_SIZE) & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+        if (next.Handler != PAGE_ROM || next.Read != page.Read + MEMORY_PAGE_SIZE) {
+            return 0;
+        }
+    }
+
+    const byte * code = page.Read + offset;
+
+    // LDA INTIM, then BPL/BMI/BNE/BEQ back to it
+    word address = (code[1] | (code[2] << 8)) & ADDRESS_MASK;
+    if (code[0] != 0xAD || address != ADDR_INTIM || code[4] != 0xFB) {
+        return 0;
+    }
+
+    byte branch = code[3];
+    if (!IsIn(branch, { 0x10, 0x30, 0xD0, 0xF0 })) {
+        return 0;
+    }
+
+    // LDA Absolute, and the branch taken back
+    constexpr uint64_t LOOP_CYCLES = 4 + 3;
+
+    // Stop short of the end of the frame, which DoFrame has to see happen
+    uint64_t frameClocks = ((262 - MemoryLine) * 228) - MemoryColumn;
+    uint64_t maxIterations = (frameClocks - 1) / (LOOP_CYCLES * 3);
+
+    uint64_t iterations = 0;
+    while (iterations < maxIterations) {
+        byte value = INTIM;
+
+        bool taken = false;
+        switch (branch) {
+        case 0x10: taken = !(value & 0x80); break; // BPL
+        case 0x30: taken = (value & 0x80);  break; // BMI
+        case 0xD0: taken = (value != 0);    break; // BNE
+        case 0xF0: taken = (value == 0);    break; // BEQ
         }
+
+        // The last iteration is left to run normally
+        if (!taken) {
+            break;
+        }
+
+        // Reading INTIM clears the flag, before the PIA runs for the rest of the iteration
+        TIMINT.Timer = 0;
+        A = value;
+        SET_NZ(A);
+
+        AdvancePIA(LOOP_CYCLES);
+
+        ++iterations;
     }
 
+    if (iterations == 0) {
+        return 0;
+    }
+
+    uint64_t cycles = iterations * LOOP_CYCLES;
+
+    CPUCycleCount += cycles;
+    InstructionCount += iterations * 2;
+    IdleInstructionCount += iterations * 2;
+
+    AdvanceTIA(cycles * 3);
+
+    return cycles;
+}
+
+void Emulator::TickCPU()
+{
+    if (WSYNC) {
+        CPUCycleCount += 1;
+        return;
+    }
+
+    if (Debug && Debug->Breakpoint == PC) {
+        IsPlaying = false;
+        IsDrawing = false;
+        Debug->Breakpoint = -1;
+    }
+
+    byte opcode = NextByte();
+
+    (this->*OPCODE_TABLE[opcode])();
+
+    ++InstructionCount;
+
     // poof
     //printf("SP=%02X A=%02X X=%02X Y=%02X\n",SP, A, X, Y);
     //printf("C=%02X Z=%02X I=%02X D=%02X V=%02X N=%02X\n", C, Z, I, D, V, N);
     //printRAMGrid(RAM);
-}
\ No newline at end of file
+}
+
+#if defined(FREYA2600_THREADED_INTERPRETER)
+
+void Emulator::RunThreaded()
+{
+    #define OPCODE_LABEL(OP) &&op_##OP,
+
+    static const void * const LABELS[256] = {
+        FOR_EACH_OPCODE(OPCODE_LABEL)
+    };
+
+    uint64_t beforeInstCycles = CPUCycleCount;
+
+    // Every handler ends with its own copy of the dispatch, so each opcode gets its own indirect branch
+    #define OPCODE_BODY(OP) \
+        op_##OP: \
+            if constexpr (0x##OP == 0xAD) { \
+                if (IdleLoopSkipEnabled) { \
+                    beforeInstCycles += SkipIdleLoop(PC - 1); \
+                } \
+            } \
+            Execute<0x##OP>(); \
+            ++InstructionCount; \
+            TickFramePeripherals(CPUCycleCount - beforeInstCycles); \
+            if (WSYNC || !IsDrawing) { \
+                return; \
+            } \
+            beforeInstCycles = CPUCycleCount; \
+            goto *LABELS[NextByte()];
+
+    goto *LABELS[NextByte()];
+
+    FOR_EACH_OPCODE(OPCODE_BODY)
+}
+
+#endif // FREYA2600_THREADED_INTERPRETER
@@ -0,0 +1,423 @@
+#include "Emulator.hpp"
+#include "Constants.hpp"
+#include "MapperDetection.hpp"
+
+#include <algorithm>
+#include <array>
+
+// The cartridge port only has 12 address lines, so anything past 4K of ROM has to be switched in a piece at a time
+// Each scheme is a policy struct, flattened into a MapperInfo so that the hot path is one indirect call
+
+// Hotspots are all in the last page of ROM, so that page is the only one that can't be read directly
+constexpr word HOTSPOT_PAGE = 0x1F80;
+
+// The start of the whole ROM image, for mappers that switch less than a bank at a time
+static inline const byte * ROMStart(Emulator * emu)
+{
+    return &emu->ROM[0][0];
+}
+
+///
+/// 2K and 4K
+///
+
+struct MapperNone
+{
+    static constexpr const char * NAME = "None";
+    static constexpr size_t SLICE_SIZE = ROM_BANK_SIZE;
+    static constexpr size_t HOTSPOT_START = ROM_BANK_SIZE;
+    static constexpr bool WATCHES_TIA = false;
+
+    static void Reset(Emulator * emu)
+    {
+        emu->MapPages(0x1000, 0x1000, nullptr, nullptr, PAGE_ROM);
+        emu->SetROMBank(0);
+    }
+
+    static byte Read(Emulator *, word, bool)
+    {
+        return 0;
+    }
+
+    static void Write(Emulator *, word, byte)
+    {
+    }
+
+}; // struct MapperNone
+
+///
+/// F8, F6, F4 and FA
+///
+
+// Accessing FirstHotspot + n switches in bank n
+// RAMSize bytes of RAM sit at the start of ROM, written through the first half and read through the second
+template <word FirstHotspot, word LastHotspot, size_t RAMSize>
+struct MapperStandard
+{
+    static constexpr size_t BANK_COUNT = (LastHotspot - FirstHotspot) + 1;
+    static constexpr size_t SLICE_SIZE = ROM_BANK_SIZE;
+    static constexpr size_t HOTSPOT_START = (HOTSPOT_PAGE & (ROM_BANK_SIZE - 1));
+    static constexpr bool WATCHES_TIA = false;
+
+    static_assert(FirstHotspot >= HOTSPOT_PAGE, "Hotspots have to be in the last page of ROM");
+    static_assert(RAMSize * 2 <= sizeof(Emulator::EXTRAM), "Not enough EXTRAM");
+
+    static void Reset(Emulator * emu)
+    {
+        emu->MapPages(0x1000, 0x1000, nullptr, nullptr, PAGE_ROM);
+
+        if constexpr (RAMSize > 0) {
+            emu->MapPages(0x1000, RAMSize, nullptr, emu->EXTRAM, PAGE_MAPPER);
+            emu->MapPages(0x1000 + RAMSize, RAMSize, emu->EXTRAM, nullptr, PAGE_MAPPER);
+        }
+
+        emu->MapPages(HOTSPOT_PAGE, MEMORY_PAGE_SIZE, nullptr, nullptr, PAGE_MAPPER);
+
+        // Most games only have their startup code in the last bank
+        emu->SetROMBank(BANK_COUNT - 1);
+    }
+
+    static void Switch(Emulator * emu, word address)
+    {
+        if (address >= FirstHotspot && address <= LastHotspot) {
+            emu->SetROMBank(address - FirstHotspot);
+        }
+    }
+
+    static byte Read(Emulator * emu, word address, bool tick)
+    {
+        address = (address & ADDRESS_MASK);
+
+        // Reading the write port of the RAM
+        if (address < HOTSPOT_PAGE) {
+            return 0;
+        }
+
+        // Peeking from the debugger shouldn't switch banks
+        if (tick) {
+            Switch(emu, address);
+        }
+
+        return emu->ROM[emu->ROMBank % emu->ROMBankCount][address & (ROM_BANK_SIZE - 1)];
+    }
+
+    static void Write(Emulator * emu, word address, byte)
+    {
+        address = (address & ADDRESS_MASK);
+
+        // Writing to the read port of the RAM does nothing
+        if (address >= HOTSPOT_PAGE) {
+            Switch(emu, address);
+        }
+    }
+
+}; // struct MapperStandard
+
+struct MapperF8 : MapperStandard<0x1FF8, 0x1FF9, 0>
+{
+    static constexpr const char * NAME = "F8";
+};
+
+struct MapperF8SC : MapperStandard<0x1FF8, 0x1FF9, 0x80>
+{
+    static constexpr const char * NAME = "F8SC";
+};
+
+struct MapperF6 : MapperStandard<0x1FF6, 0x1FF9, 0>
+{
+    static constexpr const char * NAME = "F6";
+};
+
+struct MapperF6SC : MapperStandard<0x1FF6, 0x1FF9, 0x80>
+{
+    static constexpr const char * NAME = "F6SC";
+};
+
+struct MapperF4 : MapperStandard<0x1FF4, 0x1FFB, 0>
+{
+    static constexpr const char * NAME = "F4";
+};
+
+struct MapperF4SC : MapperStandard<0x1FF4, 0x1FFB, 0x80>
+{
+    static constexpr const char * NAME = "F4SC";
+};
+
+struct MapperFA : MapperStandard<0x1FF8, 0x1FFA, 0x100>
+{
+    static constexpr const char * NAME = "FA";
+};
+
+///
+/// E0
+///
+
+// Four 1K slots, the first three switch between the eight 1K slices of ROM and the last is always slice 7
+// 1FE0 - 1FE7 select the slice for slot 0, 1FE8 - 1FEF for slot 1, and 1FF0 - 1FF7 for slot 2
+struct MapperE0
+{
+    static constexpr const char * NAME = "E0";
+    static constexpr size_t SLICE_SIZE = 0x400;
+    static constexpr size_t HOTSPOT_START = (HOTSPOT_PAGE & (ROM_BANK_SIZE - 1));
+    static constexpr bool WATCHES_TIA = false;
+
+    static void Select(Emulator * emu, unsigned slot, unsigned slice)
+    {
+        emu->MapperSlots[slot] = slice;
+        emu->MapPages(0x1000 + (slot * SLICE_SIZE), SLICE_SIZE, ROMStart(emu) + (slice * SLICE_SIZE), nullptr, PAGE_ROM);
+
+        // Every combination of slices gets its own bank number
+        emu->ROMBank = emu->MapperSlots[0] | (emu->MapperSlots[1] << 3) | (emu->MapperSlots[2] << 6);
+    }
+
+    static void Reset(Emulator * emu)
+    {
+        Select(emu, 0, 4);
+        Select(emu, 1, 5);
+        Select(emu, 2, 6);
+        Select(emu, 3, 7);
+
+        emu->MapPages(HOTSPOT_PAGE, MEMORY_PAGE_SIZE, nullptr, nullptr, PAGE_MAPPER);
+    }
+
+    static void Switch(Emulator * emu, word address)
+    {
+        if (address >= 0x1FE0 && address <= 0x1FF7) {
+            unsigned slot = (address - 0x1FE0) / 8;
+            Select(emu, slot, address & 0x07);
+        }
+    }
+
+    static byte Read(Emulator * emu, word address, bool tick)
+    {
+        address = (address & ADDRESS_MASK);
+
+        if (tick) {
+            Switch(emu, address);
+        }
+
+        return ROMStart(emu)[(7 * SLICE_SIZE) + (address & (SLICE_SIZE - 1))];
+    }
+
+    static void Write(Emulator * emu, word address, byte)
+    {
+        Switch(emu, (address & ADDRESS_MASK));
+    }
+
+}; // struct MapperE0
+
+///
+/// E7
+///
+
+// 1000 - 17FF is one of the first seven 2K slices of ROM, or 1K of RAM written through 1000 and read through 1400
+// 1800 - 19FF is one of four 256 byte banks of RAM, written through 1800 and read through 1900
+// 1A00 - 1FFF is always the end of slice 7
+// 1FE0 - 1FE6 select a slice of ROM, 1FE7 selects the 1K of RAM, and 1FE8 - 1FEB select a bank of the 256 byte RAM
+struct MapperE7
+{
+    static constexpr const char * NAME = "E7";
+    static constexpr size_t SLICE_SIZE = 0x800;
+    static constexpr size_t HOTSPOT_START = (HOTSPOT_PAGE & (ROM_BANK_SIZE - 1));
+    static constexpr bool WATCHES_TIA = false;
+
+    static constexpr unsigned RAM_SLICE = 7;
+
+    static void Update(Emulator * emu)
+    {
+        unsigned slice = emu->MapperSlots[0];
+        unsigned bank = emu->MapperSlots[1];
+
+        if (slice == RAM_SLICE) {
+            emu->MapPages(0x1000, 0x400, nullptr, emu->EXTRAM, PAGE_MAPPER);
+            emu->MapPages(0x1400, 0x400, emu->EXTRAM, nullptr, PAGE_MAPPER);
+        }
+        else {
+            emu->MapPages(0x1000, SLICE_SIZE, ROMStart(emu) + (slice * SLICE_SIZE), nullptr, PAGE_ROM);
+        }
+
+        byte * ram = emu->EXTRAM + 0x400 + (bank * 0x100);
+        emu->MapPages(0x1800, 0x100, nullptr, ram, PAGE_MAPPER);
+        emu->MapPages(0x1900, 0x100, ram, nullptr, PAGE_MAPPER);
+
+        emu->ROMBank = slice | (bank << 3);
+    }
+
+    static void Reset(Emulator * emu)
+    {
+        emu->MapperSlots[0] = 0;
+        emu->MapperSlots[1] = 0;
+        Update(emu);
+
+        emu->MapPages(0x1A00, 0x600, ROMStart(emu) + (7 * SLICE_SIZE) + 0x200, nullptr, PAGE_ROM);
+        emu->MapPages(HOTSPOT_PAGE, MEMORY_PAGE_SIZE, nullptr, nullptr, PAGE_MAPPER);
+    }
+
+    static void Switch(Emulator * emu, word address)
+    {
+        if (address >= 0x1FE0 && address <= 0x1FE7) {
+            emu->MapperSlots[0] = (address & 0x07);
+            Update(emu);
+        }
+        else if (address >= 0x1FE8 && address <= 0x1FEB) {
+            emu->MapperSlots[1] = (address & 0x03);
+            Update(emu);
+        }
+    }
+
+    static byte Read(Emulator * emu, word address, bool tick)
+    {
+        address = (address & ADDRESS_MASK);
+
+        // Reading the write port of either RAM
+        if (address < HOTSPOT_PAGE) {
+            return 0;
+        }
+
+        if (tick) {
+            Switch(emu, address);
+        }
+
+        return ROMStart(emu)[(7 * SLICE_SIZE) + (address & (SLICE_SIZE - 1))];
+    }
+
+    static void Write(Emulator * emu, word address, byte)
+    {
+        address = (address & ADDRESS_MASK);
+
+        if (address >= HOTSPOT_PAGE) {
+            Switch(emu, address);
+        }
+    }
+
+}; // struct MapperE7
+
+///
+/// 3F
+///
+
+// Writing to 003F selects the 2K slice of ROM at 1000 - 17FF, 1800 - 1FFF is always the last slice
+struct Mapper3F
+{
+    static constexpr const char * NAME = "3F";
+    static constexpr size_t SLICE_SIZE = 0x800;
+    static constexpr size_t HOTSPOT_START = ROM_BANK_SIZE;
+    static constexpr bool WATCHES_TIA = true;
+
+    static size_t SliceCount(Emulator * emu)
+    {
+        return std::max<size_t>(emu->ROMSize / SLICE_SIZE, 1);
+    }
+
+    static void Select(Emulator * emu, unsigned slice)
+    {
+        slice %= SliceCount(emu);
+
+        emu->MapPages(0x1000, SLICE_SIZE, ROMStart(emu) + (slice * SLICE_SIZE), nullptr, PAGE_ROM);
+        emu->ROMBank = slice;
+    }
+
+    static void Reset(Emulator * emu)
+    {
+        Select(emu, 0);
+
+        emu->MapPages(0x1800, SLICE_SIZE, ROMStart(emu) + ((SliceCount(emu) - 1) * SLICE_SIZE), nullptr, PAGE_ROM);
+    }
+
+    static byte Read(Emulator *, word, bool)
+    {
+        return 0;
+    }
+
+    // Only sees writes to the TIA
+    static void Write(Emulator * emu, word address, byte data)
+    {
+        if ((address & ADDRESS_MASK) == 0x003F) {
+            Select(emu, data);
+        }
+    }
+
+}; // struct Mapper3F
+
+///
+/// FE
+///
+
+// The two banks are told apart by A13, which the cartridge port doesn't have, so it's taken from the unmasked address
+// Code in bank 0 runs at F000 - FFFF and bank 1 at D000 - DFFF, the JSR and RTS between them do the switching
+struct MapperFE
+{
+    static constexpr const char * NAME = "FE";
+    static constexpr size_t SLICE_SIZE = ROM_BANK_SIZE;
+    static constexpr size_t HOTSPOT_START = ROM_BANK_SIZE;
+    static constexpr bool WATCHES_TIA = false;
+
+    static void Reset(Emulator * emu)
+    {
+        emu->MapPages(0x1000, 0x1000, nullptr, nullptr, PAGE_MAPPER);
+        emu->ROMBank = 0;
+    }
+
+    static byte Read(Emulator * emu, word address, bool tick)
+    {
+        unsigned bank = ((address & 0x2000) ? 0 : 1);
+
+        if (tick) {
+            emu->ROMBank = bank;
+        }
+
+        return emu->ROM[bank % emu->ROMBankCount][address & (ROM_BANK_SIZE - 1)];
+    }
+
+    static void Write(Emulator *, word, byte)
+    {
+    }
+
+}; // struct MapperFE
+
+template <typename Policy>
+constexpr MapperInfo MakeMapperInfo()
+{
+    return {
+        .Name = Policy::NAME,
+        .SliceSize = Policy::SLICE_SIZE,
+        .HotspotStart = Policy::HOTSPOT_START,
+        .WatchesTIA = Policy::WATCHES_TIA,
+        .Reset = &Policy::Reset,
+        .Read = &Policy::Read,
+        .Write = &Policy::Write,
+    };
+}
+
+// In the order of MAPPER_*
+static constexpr std::array<MapperInfo, MAPPER_COUNT> MAPPERS = {
+    MakeMapperInfo<MapperNone>(),
+    MakeMapperInfo<MapperF8>(),
+    MakeMapperInfo<MapperF8SC>(),
+    MakeMapperInfo<MapperF6>(),
+    MakeMapperInfo<MapperF6SC>(),
+    MakeMapperInfo<MapperF4>(),
+    MakeMapperInfo<MapperF4SC>(),
+    MakeMapperInfo<MapperE0>(),
+    MakeMapperInfo<MapperE7>(),
+    MakeMapperInfo<Mapper3F>(),
+    MakeMapperInfo<MapperFE>(),
+    MakeMapperInfo<MapperFA>(),
+};
+
+void Emulator::SetMapper(byte type)
+{
+    if (type >= MAPPER_COUNT) {
+        type = MAPPER_NONE;
+    }
+
+    MapperType = type;
+    Mapper = &MAPPERS[type];
+
+    MapMemory();
+}
+
+byte Emulator::DetectMapper()
+{
+    return DetectMappers(&ROM[0][0], ROMSize).Best();
+}
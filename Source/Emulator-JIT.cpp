@@ -0,0 +1,560 @@
+#include "Emulator.hpp"
+
+#if defined(FREYA2600_JIT)
+
+#if !defined(__x86_64__) || defined(_WIN32)
+    #error "FREYA2600_JIT emits x86-64 code for the System V calling convention"
+#endif
+
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+
+#include <sys/mman.h>
+
+// Number of times a block has to run before it is worth translating
+constexpr unsigned JIT_THRESHOLD = 16;
+
+constexpr size_t JIT_CODE_SIZE = 4 * 1024 * 1024;
+
+// Enough for the largest block, MAX_BLOCK_INSTRUCTIONS of the longest translation
+constexpr size_t JIT_MAX_BLOCK_SIZE = 8 * 1024;
+
+// Status Register bits
+constexpr byte FLAG_C = 0x01;
+constexpr byte FLAG_I = 0x04;
+constexpr byte FLAG_D = 0x08;
+constexpr byte FLAG_V = 0x40;
+
+// TIA clocks in a frame, and the point where the TIA wraps back to line 0
+constexpr unsigned TIA_CLOCKS_PER_LINE = 228;
+constexpr unsigned TIA_LINES_PER_FRAME = 262;
+
+///
+/// Called from translated code
+///
+
+// Checks that a run of cycles can be ticked all at once without running past the end of the frame
+static bool JitCanRun(Emulator * emu, unsigned cycles)
+{
+    unsigned clocksLeft = ((TIA_LINES_PER_FRAME - emu->MemoryLine) * TIA_CLOCKS_PER_LINE) - emu->MemoryColumn;
+    return (cycles * 3 <= clocksLeft);
+}
+
+// Catches the PIA and TIA up with a run of native instructions
+static bool JitSync(Emulator * emu, unsigned length, unsigned cycles, unsigned count)
+{
+    emu->PC += length;
+    emu->CPUCycleCount += cycles;
+    emu->InstructionCount += count;
+
+    emu->TickFramePeripherals(cycles);
+
+    return emu->IsDrawing;
+}
+
+// Runs an instruction that may touch the TIA, PIA or cartridge through ReadByte and WriteByte
+static bool JitStep(Emulator * emu, const DecodedInstruction * inst, int bank)
+{
+    return emu->StepDecoded(*inst, bank);
+}
+
+///
+/// x86-64 Encoding
+///
+
+// Emits the handful of instructions the translator needs, with the emulator held in RBX
+class Assembler
+{
+public:
+
+    byte * Cursor;
+
+    Assembler(byte * cursor)
+        : Cursor(cursor)
+    { }
+
+    void Byte(byte value) {
+        *Cursor++ = value;
+    }
+
+    void Bytes(std::initializer_list<byte> values) {
+        for (byte value : values) {
+            Byte(value);
+        }
+    }
+
+    void Dword(uint32_t value) {
+        memcpy(Cursor, &value, sizeof(value));
+        Cursor += sizeof(value);
+    }
+
+    void Qword(uint64_t value) {
+        memcpy(Cursor, &value, sizeof(value));
+        Cursor += sizeof(value);
+    }
+
+    // op r8, [rbx + disp32], where reg is the register field of the ModRM byte
+    void Memory(std::initializer_list<byte> op, byte reg, uint32_t disp) {
+        Bytes(op);
+        Byte(0x80 | (reg << 3) | 0b011);
+        Dword(disp);
+    }
+
+    // mov al, [rbx + disp32]
+    void LoadAL(uint32_t disp) { Memory({ 0x8A }, 0, disp); }
+
+    // mov [rbx + disp32], al
+    void StoreAL(uint32_t disp) { Memory({ 0x88 }, 0, disp); }
+
+    // mov al, imm8
+    void MoveAL(byte value) { Bytes({ 0xB0, value }); }
+
+    // movzx ecx, byte [rbx + disp32]
+    void LoadECX(uint32_t disp) { Memory({ 0x0F, 0xB6 }, 1, disp); }
+
+    // mov [rbx + disp32], cl
+    void StoreCL(uint32_t disp) { Memory({ 0x88 }, 1, disp); }
+
+    // and ecx, imm8
+    void AndECX(byte value) { Bytes({ 0x83, 0xE1, value }); }
+
+    // and byte [rbx + disp32], imm8
+    void AndMemory(uint32_t disp, byte value) { Memory({ 0x80 }, 4, disp); Byte(value); }
+
+    // or byte [rbx + disp32], imm8
+    void OrMemory(uint32_t disp, byte value) { Memory({ 0x80 }, 1, disp); Byte(value); }
+
+    // Ors the flag selected by a SETcc into ECX, shifted up by shift bits
+    void SetFlag(byte condition, unsigned shift) {
+        Bytes({ 0x0F, condition, 0xC2 });   // setcc dl
+        Bytes({ 0x0F, 0xB6, 0xD2 });        // movzx edx, dl
+        for (unsigned i = 0; i < shift; ++i) {
+            Bytes({ 0x01, 0xD2 });          // add edx, edx
+        }
+        Bytes({ 0x09, 0xD1 });              // or ecx, edx
+    }
+
+    // Keeps the value in AL as the result N and Z are evaluated from
+    void SetNZ(uint32_t dispN, uint32_t dispZ) {
+        StoreAL(dispN);
+        Bytes({ 0x0F, 0xB6, 0xD0 });        // movzx edx, al
+        Memory({ 0x66, 0x89 }, 2, dispZ);   // mov [rbx + dispZ], dx
+    }
+
+    // Calls a function with the emulator as the first argument and up to three more
+    void Call(const void * function, uint64_t arg1 = 0, uint32_t arg2 = 0, uint32_t arg3 = 0) {
+        Bytes({ 0x48, 0x89, 0xDF });        // mov rdi, rbx
+        Bytes({ 0x48, 0xBE });              // mov rsi, imm64
+        Qword(arg1);
+        Byte(0xBA);                         // mov edx, imm32
+        Dword(arg2);
+        Byte(0xB9);                         // mov ecx, imm32
+        Dword(arg3);
+        Bytes({ 0x48, 0xB8 });              // mov rax, imm64
+        Qword((uint64_t)function);
+        Bytes({ 0xFF, 0xD0 });              // call rax
+    }
+
+    // Jumps to the exit if the last call returned false, returns the displacement to patch
+    byte * ExitIfFalse() {
+        Bytes({ 0x84, 0xC0 });              // test al, al
+        Bytes({ 0x0F, 0x84 });              // jz rel32
+        byte * patch = Cursor;
+        Dword(0);
+        return patch;
+    }
+
+};
+
+///
+/// Translation
+///
+
+// Offsets of the registers the native instructions work on, relative to the emulator in RBX
+struct RegisterOffsets
+{
+    uint32_t A, X, Y, SP, SR, FlagResultN, FlagResultZ, RAM, DirtyLines;
+
+    RegisterOffsets(Emulator * emu)
+    {
+        auto offset = [emu](const void * member) {
+            return (uint32_t)((const byte *)member - (const byte *)emu);
+        };
+
+        A = offset(&emu->A);
+        X = offset(&emu->X);
+        Y = offset(&emu->Y);
+        SP = offset(&emu->SP);
+        SR = offset(&emu->SR);
+        FlagResultN = offset(&emu->FlagResultN);
+        FlagResultZ = offset(&emu->FlagResultZ);
+        RAM = offset(emu->RAM);
+        DirtyLines = offset(&emu->DirtyLines[0]);
+    }
+};
+
+// Cycles taken by an instruction that only touches registers and RAM, or 0 if it has to run through its handler
+static unsigned NativeCycles(const DecodedInstruction& inst)
+{
+    // Zero Page addresses below $80 are the TIA
+    bool ram = (inst.Operand >= 0x80);
+
+    switch (inst.Opcode) {
+    // Implied
+    case 0x88: case 0xA8: case 0xC8: case 0xE8:
+    case 0x18: case 0x38: case 0x58: case 0x78:
+    case 0x98: case 0xB8: case 0xD8: case 0xF8:
+    case 0x8A: case 0x9A: case 0xAA: case 0xBA:
+    case 0xCA: case 0xEA:
+        return 2;
+
+    // ORA, AND, EOR, LDA, LDX, LDY, CMP, CPX, CPY #Immediate
+    case 0x09: case 0x29: case 0x49: case 0xA9:
+    case 0xA2: case 0xA0: case 0xC9: case 0xE0:
+    case 0xC0:
+        return 2;
+
+    // ORA, AND, EOR, LDA, LDX, LDY, CMP, CPX, CPY, STA, STX, STY Zero Page
+    case 0x05: case 0x25: case 0x45: case 0xA5:
+    case 0xA6: case 0xA4: case 0xC5: case 0xE4:
+    case 0xC4: case 0x85: case 0x86: case 0x84:
+        return (ram ? 3 : 0);
+
+    // INC, DEC Zero Page
+    case 0xE6: case 0xC6:
+        return (ram ? 4 : 0);
+    }
+
+    return 0;
+}
+
+// Emits an instruction that NativeCycles accepted, matching its handler in Emulator-CPU.cpp
+static void EmitNative(Assembler& as, const RegisterOffsets& reg, const DecodedInstruction& inst)
+{
+    bool immediate = (inst.Opcode & 0x0F) == 0x09 || (inst.Opcode & 0x0F) == 0x00 || inst.Opcode == 0xA2;
+    uint32_t memory = reg.RAM + (inst.Operand - 0x80);
+
+    // Emits op al, imm8 or op al, [memory] for the operand of the instruction
+    auto aluOperand = [&](byte opImmediate, byte opMemory) {
+        if (immediate) {
+            as.Bytes({ opImmediate, (byte)inst.Operand });
+        }
+        else {
+            as.Memory({ opMemory }, 0, memory);
+        }
+    };
+
+    // Loads AL with the operand of the instruction
+    auto loadOperand = [&]() {
+        if (immediate) {
+            as.MoveAL((byte)inst.Operand);
+        }
+        else {
+            as.LoadAL(memory);
+        }
+    };
+
+    // Stores AL into a register, setting N and Z from it
+    auto storeNZ = [&](uint32_t disp) {
+        as.StoreAL(disp);
+        as.SetNZ(reg.FlagResultN, reg.FlagResultZ);
+    };
+
+    // Stores AL into the RAM operand, marking its line dirty like WriteByte would
+    auto storeRAM = [&]() {
+        as.StoreAL(memory);
+        as.OrMemory(reg.DirtyLines, (byte)(1 << ((inst.Operand & 0x7F) >> DIRTY_LINE_SHIFT)));
+    };
+
+    // CPX and CPY, N and Z come from the difference
+    auto compare = [&](uint32_t disp) {
+        as.LoadAL(disp);
+        as.LoadECX(reg.SR);
+        as.AndECX((byte)~FLAG_C);
+        aluOperand(0x3C, 0x3A);             // cmp
+        as.SetFlag(0x93, 0);                // setae
+        as.StoreCL(reg.SR);
+        aluOperand(0x2C, 0x2A);             // sub
+        as.SetNZ(reg.FlagResultN, reg.FlagResultZ);
+    };
+
+    switch (inst.Opcode) {
+    case 0x88: // DEY
+        as.LoadAL(reg.Y);
+        as.Bytes({ 0x2C, 0x01 });           // sub al, 1
+        storeNZ(reg.Y);
+        break;
+    case 0xA8: // TAY
+        as.LoadAL(reg.A);
+        storeNZ(reg.Y);
+        break;
+    case 0xC8: // INY
+        as.LoadAL(reg.Y);
+        as.Bytes({ 0x04, 0x01 });           // add al, 1
+        storeNZ(reg.Y);
+        break;
+    case 0xE8: // INX
+        as.LoadAL(reg.X);
+        as.Bytes({ 0x04, 0x01 });           // add al, 1
+        storeNZ(reg.X);
+        break;
+    case 0x18: // CLC
+        as.AndMemory(reg.SR, (byte)~FLAG_C);
+        break;
+    case 0x38: // SEC
+        as.OrMemory(reg.SR, FLAG_C);
+        break;
+    case 0x58: // CLI
+        as.AndMemory(reg.SR, (byte)~FLAG_I);
+        break;
+    case 0x78: // SEI
+        as.OrMemory(reg.SR, FLAG_I);
+        break;
+    case 0x98: // TYA
+        as.LoadAL(reg.Y);
+        storeNZ(reg.A);
+        break;
+    case 0xB8: // CLV
+        as.AndMemory(reg.SR, (byte)~FLAG_V);
+        break;
+    case 0xD8: // CLD
+        as.AndMemory(reg.SR, (byte)~FLAG_D);
+        break;
+    case 0xF8: // SED
+        as.OrMemory(reg.SR, FLAG_D);
+        break;
+    case 0x8A: // TXA
+        as.LoadAL(reg.X);
+        storeNZ(reg.A);
+        break;
+    case 0x9A: // TXS
+        as.LoadAL(reg.X);
+        as.StoreAL(reg.SP);
+        break;
+    case 0xAA: // TAX
+        as.LoadAL(reg.A);
+        storeNZ(reg.X);
+        break;
+    case 0xBA: // TSX
+        as.LoadAL(reg.SP);
+        storeNZ(reg.X);
+        break;
+    case 0xCA: // DEX
+        as.LoadAL(reg.X);
+        as.Bytes({ 0x2C, 0x01 });           // sub al, 1
+        storeNZ(reg.X);
+        break;
+    case 0xEA: // NOP
+        break;
+
+    case 0x09: case 0x05: // ORA
+        as.LoadAL(reg.A);
+        aluOperand(0x0C, 0x0A);
+        storeNZ(reg.A);
+        break;
+    case 0x29: case 0x25: // AND
+        as.LoadAL(reg.A);
+        aluOperand(0x24, 0x22);
+        storeNZ(reg.A);
+        break;
+    case 0x49: case 0x45: // EOR
+        as.LoadAL(reg.A);
+        aluOperand(0x34, 0x32);
+        storeNZ(reg.A);
+        break;
+    case 0xA9: case 0xA5: // LDA
+        loadOperand();
+        storeNZ(reg.A);
+        break;
+    case 0xA2: case 0xA6: // LDX
+        loadOperand();
+        storeNZ(reg.X);
+        break;
+    case 0xA0: case 0xA4: // LDY
+        loadOperand();
+        storeNZ(reg.Y);
+        break;
+
+    case 0xC9: case 0xC5: // CMP
+        // The handler takes N and Z from the borrow, so Z matches C and N is always clear
+        as.LoadAL(reg.A);
+        as.LoadECX(reg.SR);
+        as.AndECX((byte)~FLAG_C);
+        aluOperand(0x3C, 0x3A);             // cmp
+        as.SetFlag(0x93, 0);                // setae
+        as.StoreCL(reg.SR);
+        as.Bytes({ 0x83, 0xF2, 0x01 });     // xor edx, 1
+        as.Memory({ 0x66, 0x89 }, 2, reg.FlagResultZ);
+        as.Memory({ 0xC6 }, 0, reg.FlagResultN);
+        as.Byte(0x00);                      // mov byte [rbx + FlagResultN], 0
+        break;
+    case 0xE0: case 0xE4: // CPX
+        compare(reg.X);
+        break;
+    case 0xC0: case 0xC4: // CPY
+        compare(reg.Y);
+        break;
+
+    case 0x85: // STA
+        as.LoadAL(reg.A);
+        storeRAM();
+        break;
+    case 0x86: // STX
+        as.LoadAL(reg.X);
+        storeRAM();
+        break;
+    case 0x84: // STY
+        as.LoadAL(reg.Y);
+        storeRAM();
+        break;
+
+    case 0xE6: // INC
+        as.LoadAL(memory);
+        as.Bytes({ 0x04, 0x01 });           // add al, 1
+        storeRAM();
+        as.SetNZ(reg.FlagResultN, reg.FlagResultZ);
+        break;
+    case 0xC6: // DEC
+        as.LoadAL(memory);
+        as.Bytes({ 0x2C, 0x01 });           // sub al, 1
+        storeRAM();
+        as.SetNZ(reg.FlagResultN, reg.FlagResultZ);
+        break;
+    }
+}
+
+bool Emulator::CompileBlock(DecodedBlock * block)
+{
+    if (!JITCode) {
+        void * memory = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            printf("Failed to map memory for the JIT, falling back to the interpreter\n");
+            JITEnabled = false;
+            return false;
+        }
+
+        JITCode = (byte *)memory;
+        JITCodeUsed = 0;
+    }
+
+    if (JITCodeUsed + JIT_MAX_BLOCK_SIZE > JIT_CODE_SIZE) {
+        return false;
+    }
+
+    mprotect(JITCode, JIT_CODE_SIZE, PROT_READ | PROT_WRITE);
+
+    byte * start = JITCode + JITCodeUsed;
+    Assembler as(start);
+    RegisterOffsets reg(this);
+
+    std::vector<byte *> exits;
+
+    as.Byte(0x53);                          // push rbx
+    as.Bytes({ 0x48, 0x89, 0xFB });         // mov rbx, rdi
+
+    const auto& instructions = block->Instructions;
+    const int bank = ROMBank;
+
+    size_t index = 0;
+    while (index < instructions.size()) {
+
+        // A run of native instructions only affects registers and RAM, so the PIA and TIA can catch up at the end
+        unsigned length = 0;
+        unsigned cycles = 0;
+        unsigned count = 0;
+
+        size_t end = index;
+        while (end < instructions.size() && NativeCycles(instructions[end]) > 0) {
+            length += instructions[end].Length;
+            cycles += NativeCycles(instructions[end]);
+            ++count;
+            ++end;
+        }
+
+        if (count > 0) {
+            // Leave the end of the frame to the interpreter, so it stops on the same instruction
+            as.Call((const void *)&JitCanRun, cycles);
+            exits.push_back(as.ExitIfFalse());
+
+            for (; index < end; ++index) {
+                EmitNative(as, reg, instructions[index]);
+            }
+
+            as.Call((const void *)&JitSync, length, cycles, count);
+            exits.push_back(as.ExitIfFalse());
+        }
+
+        if (index < instructions.size()) {
+            as.Call((const void *)&JitStep, (uint64_t)&instructions[index], bank);
+            exits.push_back(as.ExitIfFalse());
+            ++index;
+        }
+    }
+
+    for (byte * patch : exits) {
+        int32_t displacement = (int32_t)(as.Cursor - (patch + 4));
+        memcpy(patch, &displacement, sizeof(displacement));
+    }
+
+    as.Byte(0x5B);                          // pop rbx
+    as.Byte(0xC3);                          // ret
+
+    JITCodeUsed += (as.Cursor - start);
+
+    mprotect(JITCode, JIT_CODE_SIZE, PROT_READ | PROT_EXEC);
+
+    block->Native = (void (*)(Emulator *))start;
+
+    return true;
+}
+
+bool Emulator::RunNative(DecodedBlock * block)
+{
+    if (!block->Native) {
+        if (++block->ExecutionCount < JIT_THRESHOLD) {
+            return false;
+        }
+
+        if (!CompileBlock(block)) {
+            // Start over once the code memory fills up, the hot blocks will be translated again
+            InvalidateNativeCode();
+
+            if (!JITEnabled || !CompileBlock(block)) {
+                return false;
+            }
+        }
+    }
+
+    uintmax_t beforeInstCount = InstructionCount;
+
+    block->Native(this);
+
+    return (InstructionCount != beforeInstCount);
+}
+
+void Emulator::InvalidateNativeCode()
+{
+    for (auto& cache : BlockCache) {
+        for (auto& block : cache) {
+            if (block) {
+                block->ExecutionCount = 0;
+                block->Native = nullptr;
+            }
+        }
+    }
+
+    JITCodeUsed = 0;
+}
+
+void Emulator::FreeNativeCode()
+{
+    if (JITCode) {
+        munmap(JITCode, JIT_CODE_SIZE);
+        JITCode = nullptr;
+    }
+
+    JITCodeUsed = 0;
+}
+
+#endif // FREYA2600_JIT
@@ -1,19 +1,236 @@
 #include "Emulator.hpp"
 #include "Constants.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <utility>
 
-uint8_t Emulator::ReadByte(word address, bool tick /*= true*/)
+void Emulator::MapMemory()
 {
-    if (tick) {
-        ++CPUCycleCount;
+    for (unsigned page = 0; page < MEMORY_PAGE_COUNT; ++page) {
+        MemoryMap[page] = { nullptr, nullptr, nullptr, PAGE_UNMAPPED };
     }
 
-    // bit mask
-    address = (address & ADDRESS_MASK);
+    // $00 - $7F TIA
+    MapPages(0x0000, 0x80, nullptr, nullptr, PAGE_TIA);
+
+    // $80 - $FF RAM
+    MapPages(0x0080, 0x80, RAM, RAM, PAGE_UNMAPPED);
+
+    // $280 - $297 PIA (AKA RIOT)
+    MapPages(0x0280, 0x80, nullptr, nullptr, PAGE_RIOT);
+
+    // $1000 - $1FFF ROM, and whatever else the cartridge puts there
+    Mapper->Reset(this);
+}
+
+void Emulator::MapPages(word address, size_t size, const byte * read, byte * write, byte handler)
+{
+    for (size_t offset = 0; offset < size; offset += MEMORY_PAGE_SIZE) {
+        MemoryMap[(address + offset) >> MEMORY_PAGE_SHIFT] = {
+            (read ? read + offset : nullptr),
+            (write ? write + offset : nullptr),
+            (write ? GetDirtyLines(write + offset) : nullptr),
+            handler,
+        };
+    }
+}
+
+byte * Emulator::GetDirtyLines(const byte * memory)
+{
+    if (memory >= RAM && memory < RAM + sizeof(RAM)) {
+        assert(memory == RAM);
+        return &DirtyLines[0];
+    }
+
+    // Every mapper puts its RAM at whole pages of EXTRAM
+    size_t offset = memory - EXTRAM;
+    assert(memory >= EXTRAM && offset < sizeof(EXTRAM) && (offset % MEMORY_PAGE_SIZE) == 0);
+    return &DirtyLines[1 + (offset / MEMORY_PAGE_SIZE)];
+}
+
+void Emulator::ClearDirtyLines()
+{
+    memset(DirtyLines, 0, sizeof(DirtyLines));
+}
+
+void Emulator::SetROMBank(int bank)
+{
+    ROMBank = bank;
+
+    // Banks past the end of the cartridge wrap around, rather than reading past the end of ROM
+    const byte * data = ROM[(unsigned)ROMBank % ROMBankCount];
+
+    // Pages left to the mapper look up ROMBank themselves
+    for (unsigned page = (0x1000 >> MEMORY_PAGE_SHIFT); page < MEMORY_PAGE_COUNT; ++page) {
+        if (MemoryMap[page].Handler == PAGE_ROM) {
+            MemoryMap[page].Read = data + ((page << MEMORY_PAGE_SHIFT) & (ROM_BANK_SIZE - 1));
+        }
+    }
+}
 
+byte Emulator::ReadIO(word address, bool tick)
+{
     //printf("ReadByte Address: 0x%04X\n", address);
 
+    switch (MemoryMap[(address & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT].Handler) {
+    case PAGE_TIA:
+        return ReadTIA(address & ADDRESS_MASK);
+    case PAGE_RIOT:
+        return ReadRIOT(address & ADDRESS_MASK);
+    case PAGE_MAPPER:
+        return Mapper->Read(this, address, tick);
+    }
+
+    // MAX GO AWAY STOP ATTACKING ME
+    // - SLW 2021
+
+    // Peeking from the debugger isn't the ROM's doing
+    if (tick) {
+        BUS_DIAGNOSTIC(BUS_UNMAPPED_READ, address, 0);
+    }
+
+    return 0;
+}
+
+byte Emulator::Peek(word address) const
+{
+    const MemoryPage& page = MemoryMap[(address & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+    if (page.Read) {
+        return page.Read[address & (MEMORY_PAGE_SIZE - 1)];
+    }
+
+    switch (page.Handler) {
+    case PAGE_TIA:
+        return PeekTIA(address & ADDRESS_MASK);
+    case PAGE_RIOT:
+        return PeekRIOT(address & ADDRESS_MASK);
+    case PAGE_MAPPER:
+        // Mappers only switch banks on reads that tick
+        return Mapper->Read(const_cast<Emulator *>(this), address, false);
+    }
+
+    return 0;
+}
+
+void Emulator::PeekRange(word address, size_t size, byte * buffer) const
+{
+    while (size > 0) {
+        const MemoryPage& page = MemoryMap[(address & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+        word offset = address & (MEMORY_PAGE_SIZE - 1);
+        size_t length = std::min<size_t>(size, MEMORY_PAGE_SIZE - offset);
+
+        if (page.Read) {
+            memcpy(buffer, page.Read + offset, length);
+        }
+        else {
+            for (size_t i = 0; i < length; ++i) {
+                buffer[i] = Peek(address + i);
+            }
+        }
+
+        address += length;
+        buffer += length;
+        size -= length;
+    }
+}
+
+void Emulator::TakeSnapshot(MachineSnapshot * snapshot) const
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    snapshot->PC = PC;
+    snapshot->SP = SP;
+    snapshot->A = A;
+    snapshot->X = X;
+    snapshot->Y = Y;
+    snapshot->SR = PeekSR();
+
+    memcpy(snapshot->RAM, RAM, sizeof(RAM));
+    snapshot->SWCHA = SWCHA._raw;
+    snapshot->SWACNT = SWACNT;
+    snapshot->SWCHB = SWCHB._raw;
+    snapshot->SWBCNT = SWBCNT;
+    snapshot->INTIM = INTIM;
+    snapshot->TIMINT = TIMINT._raw;
+    snapshot->TimerInterval = TimerInterval;
+    snapshot->TimerCounter = TimerCounter;
+
+    #define TIA_SNAPSHOT(REG) \
+        snapshot->TIA[ADDR_##REG] = REG._raw
+
+    TIA_SNAPSHOT(VSYNC);
+    TIA_SNAPSHOT(VBLANK);
+    TIA_SNAPSHOT(NUSIZ0);
+    TIA_SNAPSHOT(NUSIZ1);
+    TIA_SNAPSHOT(COLUP0);
+    TIA_SNAPSHOT(COLUP1);
+    TIA_SNAPSHOT(COLUPF);
+    TIA_SNAPSHOT(COLUBK);
+    TIA_SNAPSHOT(CTRLPF);
+    TIA_SNAPSHOT(REFP0);
+    TIA_SNAPSHOT(REFP1);
+    TIA_SNAPSHOT(AUDC0);
+    TIA_SNAPSHOT(AUDC1);
+    TIA_SNAPSHOT(AUDF0);
+    TIA_SNAPSHOT(AUDF1);
+    TIA_SNAPSHOT(AUDV0);
+    TIA_SNAPSHOT(AUDV1);
+    TIA_SNAPSHOT(ENAM0);
+    TIA_SNAPSHOT(ENAM1);
+    TIA_SNAPSHOT(ENABL);
+    TIA_SNAPSHOT(HMP0);
+    TIA_SNAPSHOT(HMP1);
+    TIA_SNAPSHOT(HMM0);
+    TIA_SNAPSHOT(HMM1);
+    TIA_SNAPSHOT(HMBL);
+    TIA_SNAPSHOT(VDELP0);
+    TIA_SNAPSHOT(VDELP1);
+    TIA_SNAPSHOT(VDELBL);
+    TIA_SNAPSHOT(RESMP0);
+    TIA_SNAPSHOT(RESMP1);
+
+    #undef TIA_SNAPSHOT
+
+    snapshot->TIA[ADDR_GRP0] = GRP0;
+    snapshot->TIA[ADDR_GRP1] = GRP1;
+    snapshot->TIA[ADDR_PF0] = PF[0];
+    snapshot->TIA[ADDR_PF1] = PF[1];
+    snapshot->TIA[ADDR_PF2] = PF[2];
+
+    snapshot->Collisions = Collisions;
+
+    snapshot->WSYNC = WSYNC;
+    snapshot->MemoryLine = MemoryLine;
+    snapshot->MemoryColumn = MemoryColumn;
+
+    snapshot->ROMBank = ROMBank;
+
+    snapshot->CPUCycleCount = CPUCycleCount;
+    snapshot->TIACycleCount = TIACycleCount;
+    snapshot->InstructionCount = InstructionCount;
+}
+
+byte Emulator::ReadTIA(word address)
+{
+    // Only the low 4 bits are decoded, leaving nothing at $xE and $xF
+    if (address <= 0x3D && (address & 0x0F) > ADDR_INPT5) {
+        BUS_DIAGNOSTIC(BUS_UNDEFINED_TIA_READ, address, 0);
+    }
+
+    // The collision latches have to catch up with everything drawn so far
+    if ((address & 0x0F) <= ADDR_CXPPMM) {
+        FlushTIA();
+    }
+
+    return PeekTIA(address);
+}
+
+byte Emulator::PeekTIA(word address) const
+{
     // TIA Chip
     // $00 - $7F TIA
     // $00-$2C TIA (write)
@@ -21,29 +238,14 @@ uint8_t Emulator::ReadByte(word address, bool tick /*= true*/)
     if (address >= 0x00 && address <= 0x3D) {
         switch (address & 0x0F) {
         case ADDR_CXM0P:  // Read: Collision D7=(M0;P1); D6=(M0,P0)
-            //printf("READ CXM0P\n");
-            break;
         case ADDR_CXM1P:  // Read: Collision D7=(M1;P0); D6=(M1,P1)
-            //printf("READ CXM1P\n");
-            break;
         case ADDR_CXP0FB:  // Read: Collision D7=(P0;PF); D6=(P0,BL)
-            //printf("READ CXP0FB\n");
-            break;
         case ADDR_CXP1FB:  // Read: Collision D7=(P1;PF); D6=(P1;BL)
-            //printf("READ CXP1FB\n");
-            break;
         case ADDR_CXM0FB:  // Read: Collision D7=(M0;PF); D6=(M0;BL)
-            //printf("READ CXM0FB\n");
-            break;
         case ADDR_CXM1FB:  // Read: Collision D7=(M1;PF); D6=(M1;BL)
-            //printf("READ CXM1FB\n");
-            break;
         case ADDR_CXBLPF:  // Read: Collision D7=(BL;PF); D6=(unused)
-            //printf("READ CXBLPF\n");
-            break;
         case ADDR_CXPPMM:  // Read: Collision D7=(P0;P1); D6=(M0;M1)
-            //printf("READ CXPPMM\n");
-            break;
+            return (byte)(((Collisions >> ((address & 0x0F) * 2)) & 0b11) << 6);
         case ADDR_INPT0:  // Read: Pot port D7
             //printf("READ INPT0\n");
             break;
@@ -62,17 +264,41 @@ uint8_t Emulator::ReadByte(word address, bool tick /*= true*/)
         case ADDR_INPT5:  // Read: P2 joystick trigger: D7
             //printf("READ INPT5\n");
             break;
-        default:
-            printf("UNDEFINED READ IN TIA AREA 0x%04X \n", address);
-            break;
         }
 
     }
 
-    // Actual RAM
-    if (address >= 0x80 && address <= 0xFF) {
-        return RAM[address - 0x80];
+    return 0;
+}
+
+byte Emulator::ReadRIOT(word address)
+{
+    // PIA (AKA RIOT) (I/O, Timer)
+    if (address >= 0x280 && address <= 0x297) {
+        switch (address) {
+            case ADDR_SWCHA:
+            case ADDR_SWACNT:
+            case ADDR_SWCHB:
+            case ADDR_SWBCNT:
+                break;
+            case ADDR_INTIM:  // Reading the timer clears the interrupt
+                TIMINT.Timer = 0;
+                break;
+            case ADDR_TIMINT: // Timer Interupt Flag
+                TIMINT.EdgeDetect = 0;
+                break;
+
+            default:
+                BUS_DIAGNOSTIC(BUS_UNDEFINED_RIOT_READ, address, 0);
+                break;
+        }
     }
+
+    return PeekRIOT(address);
+}
+
+byte Emulator::PeekRIOT(word address) const
+{
     // PIA (AKA RIOT) (I/O, Timer)
     if (address >= 0x280 && address <= 0x297) {
         switch (address) {
@@ -86,167 +312,195 @@ uint8_t Emulator::ReadByte(word address, bool tick /*= true*/)
             case ADDR_SWBCNT: // Port B data direction register (hardwired as input) 
                 return SWBCNT;
             case ADDR_INTIM:  // Timer output (read only)
-                TIMINT.Timer = 0;
                 return INTIM;
             case ADDR_TIMINT: // Timer Interupt Flag
-                TIMINT.EdgeDetect = 0;
                 return TIMINT._raw;
-
-            default:
-                printf("RIOT I/O READ 0x%04hX \n", address);
-                break;
         }
     }
 
-    // MAX GO AWAY STOP ATTACKING ME
-    // - SLW 2021
+    return 0;
+}
 
-    //TODO
-    // RAMR
-    // if (address >= 0x1080 && address <= 0x11FF) {
-    //     return EXTRAM[address - 0x1080];
-    // }
-
-    // $F000 to $F200 (vaguely the EXTRAM)
-    // $F000 to $F0FF (writing to EXTRAM)
-    // $F100 to $F1FF (reading to EXTRAM)
-
-    // ROM
-    if (address >= 0x1000 && address <= 0x1FFF) {
-        //return ROM[ROMBank][address - 0x1000];
-        int offset = (address - BANK_SWITCH_ADDRESS) % ROM_BANK_SIZE;
-        return ROM[ROMBank][offset];
-    }
+template <byte Register>
+void Emulator::WriteTIA(byte data)
+{
+    // Everything up to this color clock was drawn with the registers as they were
+    FlushTIA();
 
-    //sTr0be BANK
-    // The bank number is selected by reading from (or by writing any value to) specific addresses, the addresses and corresponding bank numbers are:
-    // Size   Banks  FFF4 FFF5 FFF6 FFF7 FFF8 FFF9 FFFA FFFB
-    // 2K,4K  1      -    -    -    -    -    -    -    -
-    // 8K     2      -    -    -    -    0    1    -    -
-    // 12K    3      -    -    -    -    0    1    2    -
-    // 16K    4      -    -    0    1    2    3    -    -
-    // 32K    8      0    1    2    3    4    5    6    7
-    if (address >= 0x1200 && address <= 0x1FFF) {
-        //TODO
-
-        // Execute functions
-    }
+    switch (Register) {
 
-    return 0;
+        #define TIA_WRITE(REG) \
+            case ADDR_##REG: \
+                REG._raw = data; \
+                break
+
+        case ADDR_WSYNC:  // Write: Wait for leading edge of hrz. blank (strobe)
+            WSYNC = true;
+            LastWSYNC = CPUCycleCount;
+            break;
+        case ADDR_RSYNC:  // Write: Reset hrz. sync counter (strobe)
+            break;
+            
+        // TIA_WRITE(VSYNC);  // Write: VSYNC set-clear (D1)
+        case ADDR_VSYNC:
+            VSYNC._raw = data;
+            if (!VSYNC.Enabled) {
+                MemoryLine = 0;
+                MemoryColumn = 0;
+                RenderColumn = 0;
+            }
+            break;
+        TIA_WRITE(VBLANK); // Write: VBLANK set-clear (D7-6,D1)
+        TIA_WRITE(NUSIZ0); // Write: Number-size player-missle 0 (D5-0)
+        TIA_WRITE(NUSIZ1); // Write: Number-size player-missle 1 (D5-0)
+        case ADDR_COLUP0:  // Write: Color-lum player 0 (D7-1)
+            COLUP0._raw = data;
+            UpdateRenderColors();
+            break;
+        case ADDR_COLUP1:  // Write: Color-lum player 1 (D7-1)
+            COLUP1._raw = data;
+            UpdateRenderColors();
+            break;
+        case ADDR_COLUPF:  // Write: Color-lum playfield (D7-1)
+            COLUPF._raw = data;
+            UpdateRenderColors();
+            break;
+        case ADDR_COLUBK:  // Write: Color-lum background (D7-1)
+            COLUBK._raw = data;
+            UpdateRenderColors();
+            break;
+        case ADDR_CTRLPF:  // Write: Contrl playfield ballsize & coll. (D5-4,D2-0)
+            CTRLPF._raw = data;
+            UpdateRenderColors();
+            UpdateRenderPlayfield();
+            break;
+        TIA_WRITE(REFP0);  // Write: Reflect player 0 (D3)
+        TIA_WRITE(REFP1);  // Write: Reflect player 1 (D3)
+        TIA_WRITE(AUDC0);  // Write: Audio control 0 (D3-0)
+        TIA_WRITE(AUDC1);  // Write: Audio control 1 (D4-0)
+        TIA_WRITE(AUDF0);  // Write: Audio frequency 0 (D4-0)
+        TIA_WRITE(AUDF1);  // Write: Audio frequency 1 (D3-0)
+        TIA_WRITE(AUDV0);  // Write: Audio volume 0 (D3-0)
+        TIA_WRITE(AUDV1);  // Write: Audio volume 1 (D3-0)
+        TIA_WRITE(ENAM0);  // Write: Graphics (enable) missle 0 (D1)
+        TIA_WRITE(ENAM1);  // Write: Graphics (enable) missle 1 (D1)
+        TIA_WRITE(ENABL);  // Write: Graphics (enable) ball (D1)
+        TIA_WRITE(HMP0);   // Write: Horizontal motion player 0 (D7-4)
+        TIA_WRITE(HMP1);   // Write: Horizontal motion player 1 (D7-4)
+        TIA_WRITE(HMM0);   // Write: Horizontal motion missle 0 (D7-4)
+        TIA_WRITE(HMM1);   // Write: Horizontal motion missle 1 (D7-4)
+        TIA_WRITE(HMBL);   // Write: Horizontal motion ball (D7-4)
+        TIA_WRITE(VDELP0); // Write: Vertical delay player 0 (D0)
+        TIA_WRITE(VDELP1); // Write: Vertical delay player 1 (D0)
+        TIA_WRITE(VDELBL); // Write: Vertical delay ball (D0)
+        TIA_WRITE(RESMP0); // Write: Reset missle 0 to player 0 (D1)
+        TIA_WRITE(RESMP1); // Write: Reset missle 1 to player 1 (D1)
+
+        case ADDR_GRP0:    // Write: Graphics player 0 (D7-0)
+            GRP0 = data;
+            break;
+        case ADDR_GRP1:    // Write: Graphics player 1 (D7-0)
+            GRP1 = data;
+            break;
+        case ADDR_PF0:    // Write: Playfield register byte 0 (D7-4)
+            PF[0] = data;
+            UpdateRenderPlayfield();
+            break;
+        case ADDR_PF1:    // Write: Playfield register byte 1 (D7-0)
+            PF[1] = data;
+            UpdateRenderPlayfield();
+            break;
+        case ADDR_PF2:    // Write: Playfield register byte 2 (D7-0)
+            PF[2] = data;
+            UpdateRenderPlayfield();
+            break;
+        case ADDR_RESP0:  // Write: Reset player 0 (strobe)
+            SpriteCounterP0 = 8;
+            break;
+        case ADDR_RESP1:  // Write: Reset player 1 (strobe)
+            SpriteCounterP1 = 8;
+            break;
+        case ADDR_RESM0:  // Write: Reset missle 0 (strobe)
+            break;
+        case ADDR_RESM1:  // Write: Reset missle 1 (strobe)
+            break;
+        case ADDR_RESBL:  // Write: Reset ball (strobe)
+            break;
+        case ADDR_HMOVE:  // Write: Apply horizontal motion (strobe)
+            break;
+        case ADDR_HMCLR:  // Write: Clear horizontal motion registers (strobe)
+            break;
+        case ADDR_CXCLR:  // Write: Clear collision latches (strobe)
+            Collisions = 0;
+            break;
+
+        default:
+            BUS_DIAGNOSTIC(BUS_UNDEFINED_TIA_WRITE, Register, data);
+            break;
+    }
 }
 
-void Emulator::WriteByte(word address, byte data)
+template <size_t... Registers>
+static constexpr std::array<TIAWriteHandler, sizeof...(Registers)> MakeTIAWriteTable(std::index_sequence<Registers...>)
 {
-    ++CPUCycleCount;
+    return { &Emulator::WriteTIA<Registers>... };
+}
 
-    address = (address & ADDRESS_MASK);
+// Write handlers for $00-$2C, each specialized for its register
+static constexpr auto TIA_WRITE_TABLE = MakeTIAWriteTable(std::make_index_sequence<0x2D>());
 
-    // TIA Chip
-    // $00 - $7F TIA
-    // $00-$2C TIA (write)
-    // $30-$3D TIA (read)
-    if (address >= 0x00 && address <= 0x2C) {
-        switch (address) {
+TIAWriteHandler Emulator::GetTIAWrite(word address)
+{
+    address = (address & ADDRESS_MASK);
 
-            #define TIA_WRITE(REG) \
-                case ADDR_##REG: \
-                    REG._raw = data; \
-                    break
+    if (address > 0x2C) {
+        return nullptr;
+    }
 
-            case ADDR_WSYNC:  // Write: Wait for leading edge of hrz. blank (strobe)
-                WSYNC = true;
-                LastWSYNC = CPUCycleCount;
-                break;
-            case ADDR_RSYNC:  // Write: Reset hrz. sync counter (strobe)
-                break;
-                
-            // TIA_WRITE(VSYNC);  // Write: VSYNC set-clear (D1)
-            case ADDR_VSYNC:
-                VSYNC._raw = data;
-                if (!VSYNC.Enabled) {
-                    MemoryLine = 0;
-                    MemoryColumn = 0;
-                }
-                break;
-            TIA_WRITE(VBLANK); // Write: VBLANK set-clear (D7-6,D1)
-            TIA_WRITE(NUSIZ0); // Write: Number-size player-missle 0 (D5-0)
-            TIA_WRITE(NUSIZ1); // Write: Number-size player-missle 1 (D5-0)
-            TIA_WRITE(COLUP0); // Write: Color-lum player 0 (D7-1)
-            TIA_WRITE(COLUP1); // Write: Color-lum player 1 (D7-1)
-            TIA_WRITE(COLUPF); // Write: Color-lum playfield (D7-1)
-            TIA_WRITE(COLUBK); // Write: Color-lum background (D7-1)
-            TIA_WRITE(CTRLPF); // Write: Contrl playfield ballsize & coll. (D5-4,D2-0)
-            TIA_WRITE(REFP0);  // Write: Reflect player 0 (D3)
-            TIA_WRITE(REFP1);  // Write: Reflect player 1 (D3)
-            TIA_WRITE(AUDC0);  // Write: Audio control 0 (D3-0)
-            TIA_WRITE(AUDC1);  // Write: Audio control 1 (D4-0)
-            TIA_WRITE(AUDF0);  // Write: Audio frequency 0 (D4-0)
-            TIA_WRITE(AUDF1);  // Write: Audio frequency 1 (D3-0)
-            TIA_WRITE(AUDV0);  // Write: Audio volume 0 (D3-0)
-            TIA_WRITE(AUDV1);  // Write: Audio volume 1 (D3-0)
-            TIA_WRITE(ENAM0);  // Write: Graphics (enable) missle 0 (D1)
-            TIA_WRITE(ENAM1);  // Write: Graphics (enable) missle 1 (D1)
-            TIA_WRITE(ENABL);  // Write: Graphics (enable) ball (D1)
-            TIA_WRITE(HMP0);   // Write: Horizontal motion player 0 (D7-4)
-            TIA_WRITE(HMP1);   // Write: Horizontal motion player 1 (D7-4)
-            TIA_WRITE(HMM0);   // Write: Horizontal motion missle 0 (D7-4)
-            TIA_WRITE(HMM1);   // Write: Horizontal motion missle 1 (D7-4)
-            TIA_WRITE(HMBL);   // Write: Horizontal motion ball (D7-4)
-            TIA_WRITE(VDELP0); // Write: Vertical delay player 0 (D0)
-            TIA_WRITE(VDELP1); // Write: Vertical delay player 1 (D0)
-            TIA_WRITE(VDELBL); // Write: Vertical delay ball (D0)
-            TIA_WRITE(RESMP0); // Write: Reset missle 0 to player 0 (D1)
-            TIA_WRITE(RESMP1); // Write: Reset missle 1 to player 1 (D1)
-
-            case ADDR_GRP0:    // Write: Graphics player 0 (D7-0)
-                GRP0 = data;
-                break;
-            case ADDR_GRP1:    // Write: Graphics player 1 (D7-0)
-                GRP1 = data;
-                break;
-            case ADDR_PF0:    // Write: Playfield register byte 0 (D7-4)
-                PF[0] = data;
-                break;
-            case ADDR_PF1:    // Write: Playfield register byte 1 (D7-0)
-                PF[1] = data;
-                break;
-            case ADDR_PF2:    // Write: Playfield register byte 2 (D7-0)
-                PF[2] = data;
-                break;
-            case ADDR_RESP0:  // Write: Reset player 0 (strobe)
-                SpriteCounterP0 = 8;
-                break;
-            case ADDR_RESP1:  // Write: Reset player 1 (strobe)
-                SpriteCounterP1 = 8;
-                break;
-            case ADDR_RESM0:  // Write: Reset missle 0 (strobe)
-                break;
-            case ADDR_RESM1:  // Write: Reset missle 1 (strobe)
-                break;
-            case ADDR_RESBL:  // Write: Reset ball (strobe)
-                break;
-            case ADDR_HMOVE:  // Write: Apply horizontal motion (strobe)
-                break;
-            case ADDR_HMCLR:  // Write: Clear horizontal motion registers (strobe)
-                break;
-            case ADDR_CXCLR:  // Write: Clear collision latches (strobe)
-                break;
+    return TIA_WRITE_TABLE[address];
+}
 
-            default:
-                printf("UNDEFINTED WRITE IN TIA AREA 0x%04hX \n", address);
-                break;
+void Emulator::WriteIO(word address, byte data)
+{
+    word masked = (address & ADDRESS_MASK);
+
+    switch (MemoryMap[masked >> MEMORY_PAGE_SHIFT].Handler) {
+    case PAGE_TIA:
+        // TIA Chip
+        // $00 - $7F TIA
+        // $00-$2C TIA (write)
+        // $30-$3D TIA (read)
+        if (masked <= 0x2C) {
+            (this->*TIA_WRITE_TABLE[masked])(data);
         }
-    }
 
-    if (address >= 0x2D && address <= 0x3F) {
-        //printf("ILLEGAL WRITE IN TIA AREA 0x%04hX \n", address);
-    }
+        if (masked >= 0x2D && masked <= 0x3F) {
+            BUS_DIAGNOSTIC(BUS_UNDEFINED_TIA_WRITE, masked, data);
+        }
 
-    // Actual RAM
-    if (address >= 0x80 && address <= 0xFF) {
-        RAM[address - 0x80] = data;
+        // Some mappers switch banks with writes down here
+        if (Mapper->WatchesTIA) {
+            Mapper->Write(this, address, data);
+        }
+        break;
+    case PAGE_RIOT:
+        WriteRIOT(masked, data);
+        break;
+    case PAGE_ROM:
+        // LMAO NICE TRY - FAFO
+        BUS_DIAGNOSTIC(BUS_ROM_WRITE, masked, data);
+        break;
+    case PAGE_MAPPER:
+        Mapper->Write(this, address, data);
+        break;
+    default:
+        BUS_DIAGNOSTIC(BUS_UNMAPPED_WRITE, masked, data);
+        break;
     }
+}
 
+void Emulator::WriteRIOT(word address, byte data)
+{
     // PIA (AKA RIOT) (I/O, Timer)
     if (address >= 0x280 && address <= 0x297) {
 
@@ -284,41 +538,8 @@ void Emulator::WriteByte(word address, byte data)
                 SWACNT = data;
                 break;
             default:
-                 printf("RIOT I/O WRITE 0x%04hX \n", address);
-                 break;
+                BUS_DIAGNOSTIC(BUS_UNDEFINED_RIOT_WRITE, address, data);
+                break;
         }
     }
-
-    // // RAMW
-    // if (address >= 0x1000 && address <= 0x1100) {
-    //     EXTRAM[address - 0xF000] = data;
-    // }
-    // ROM
-    if (address >= 0x1000 && address <= 0x1FFF) {
-        // LMAO NICE TRY - FAFO
-    }
-
-    if (address == BANK_SWITCH_ADDRESS) {
-        ROMBank = data;
-        printf("Switched to ROM bank: %d\n", ROMBank);
-    }
-    //TODO: DO we need this? Does the above replace this?
-    //BANK
-    //if (address == 0x3F) {
-    //    ROMBank = (data & 0b00000011);
-    //}
-
-    //sTr0be BANK
-    // The bank number is selected by reading from (or by writing any value to) specific addresses, the addresses and corresponding bank numbers are:
-    // Size   Banks  FFF4 FFF5 FFF6 FFF7 FFF8 FFF9 FFFA FFFB
-    // 2K,4K  1      -    -    -    -    -    -    -    -
-    // 8K     2      -    -    -    -    0    1    -    -
-    // 12K    3      -    -    -    -    0    1    2    -
-    // 16K    4      -    -    0    1    2    3    -    -
-    // 32K    8      0    1    2    3    4    5    6    7
-    if (address >= 0x1200 && address <= 0x1FFF) {
-        //TODO
-
-        // Execute functions
-    }
-}
\ No newline at end of file
+}
@@ -57,3 +57,40 @@ void Emulator::TickPIA()
         --INTIM;
     }
 }
+
+void Emulator::AdvancePIA(uint64_t cycles)
+{
+    while (cycles > 0) {
+        // TIM1T leaves TimerCounter one below 0, holding off the first decrement for a cycle
+        unsigned nextCounter = TimerCounter + 1;
+
+        // Once the timer has zeroed out it counts down every cycle, setting the flag whenever it passes 0
+        if (TimerInterval == 1 && nextCounter >= TimerInterval) {
+            if (cycles > INTIM) {
+                TIMINT.Timer = 1;
+            }
+
+            INTIM = (byte)(INTIM - cycles);
+            TimerCounter = 0;
+            return;
+        }
+
+        uint64_t untilInterval = (nextCounter >= TimerInterval ? 1 : TimerInterval - nextCounter + 1);
+
+        if (cycles < untilInterval) {
+            TimerCounter += cycles;
+            return;
+        }
+
+        cycles -= untilInterval;
+
+        TimerCounter = 0;
+
+        if (INTIM == 0) {
+            TimerInterval = 1;
+            TIMINT.Timer = 1;
+        }
+
+        --INTIM;
+    }
+}
@@ -1,6 +1,9 @@
 #include "Emulator.hpp"
+#include "PlayfieldExpansion.hpp"
 
+#include <algorithm>
 #include <array>
+#include <bit>
 
 SDL_Color Emulator::GetColor(uint8_t index)
 {
@@ -158,238 +161,279 @@ SDL_Color Emulator::GetColor(uint8_t index)
     };
 }
 
-void Emulator::TickTIA()
+// Scales an 8-bit channel to the bits of its mask, and moves it into place
+static inline uint32_t PackChannel(byte value, uint32_t mask)
 {
-    ++TIACycleCount;
-
-    // states = vsync, vblank, visible, overscan
-    // sub-state h-blank
-    // hmm
-
-
-    // The current column being computed
-    // if (MemoryLine <= VBLANK_CUTOFF) {
-    //     DrawState = IN_VBLANK;
-    // }
-    // if (MemoryColumn <= HBLANK_CUTOFF) {
-    //     DrawState = IN_HBLANK;
-    // }
-    // if (MemoryLine >= OVERSCAN_CUTOFF) {
-    //     DrawState = IN_OVERSCAN;
-    // }
-    // if (MemoryColumn > HBLANK_CUTOFF && MemoryLine > VBLANK_CUTOFF && MemoryLine < OVERSCAN_CUTOFF) {
-    //     DrawState = VISIBLE;
-    // }
-
-    // switch(DrawState){
-    //     case IN_VBLANK:
-    //         //TODO
-    //         break;
-
-    //     case IN_HBLANK:
-    //         //TODO
-    //         break;
-
-    //     case IN_OVERSCAN:
-    //         //TODO
-    //         break;
-
-    //     case VISIBLE:
-    if (MemoryColumn >= HBLANK_CUTOFF && MemoryLine >= VBLANK_CUTOFF && MemoryLine < OVERSCAN_CUTOFF) {
-        unsigned x = MemoryColumn - HBLANK_CUTOFF;
-        unsigned y = MemoryLine - VBLANK_CUTOFF;
-        unsigned offset = ((y * SCREEN_WIDTH) + x) * 3; // RGB
-
-        // black holez
-        if (VBLANK.Enabled) {
-            bool check = (((x / 4) + (y / 4)) % 2) == 0;
-            if (check) {
-                ScreenBuffer[offset + 0] = 255;
-                ScreenBuffer[offset + 1] = 0;
-                ScreenBuffer[offset + 2] = 255;
-            }
-            else {
-                ScreenBuffer[offset + 0] = 0;
-                ScreenBuffer[offset + 1] = 0;
-                ScreenBuffer[offset + 2] = 0;
+    if (mask == 0) {
+        return 0;
+    }
+
+    int bits = std::popcount(mask);
+    uint32_t scaled = (bits <= 8 ? (value >> (8 - bits)) : ((uint32_t)value << (bits - 8)));
+    return (scaled << std::countr_zero(mask)) & mask;
+}
+
+void Emulator::SetScreenFormat(uint32_t format)
+{
+    ScreenFormat = format;
+
+    int bpp;
+    SDL_PixelFormatEnumToMasks(format, &bpp, &ScreenMasks[0], &ScreenMasks[1], &ScreenMasks[2], &ScreenMasks[3]);
+
+    uint32_t black = MapScreenColor(0, 0, 0);
+    std::fill(std::begin(ScreenPalette), std::end(ScreenPalette), black);
+
+    for (unsigned i = 0; i < 128; ++i) {
+        SDL_Color color = GetColor(i);
+        ScreenPalette[i] = MapScreenColor(color.r, color.g, color.b);
+    }
+
+    ScreenPalette[VBLANK_MAGENTA_INDEX] = MapScreenColor(255, 0, 255);
+
+    UpdateRenderColors();
+}
+
+uint32_t Emulator::MapScreenColor(byte r, byte g, byte b) const
+{
+    return PackChannel(r, ScreenMasks[0])
+        | PackChannel(g, ScreenMasks[1])
+        | PackChannel(b, ScreenMasks[2])
+        | ScreenMasks[3];
+}
+
+void Emulator::UpdateRenderColors()
+{
+    TIARenderColors<byte>& indices = RenderState.Indices;
+
+    indices.Background = COLUBK.Index;
+    indices.Player0 = COLUP0.Index;
+    indices.Player1 = COLUP1.Index;
+
+    if (CTRLPF.ScoreColorMode) {
+        indices.PlayfieldLeft = indices.Player0;
+        indices.PlayfieldRight = indices.Player1;
+    }
+    else {
+        indices.PlayfieldLeft = COLUPF.Index;
+        indices.PlayfieldRight = indices.PlayfieldLeft;
+    }
+
+    RenderState.Colors = {
+        .Background = ScreenPalette[indices.Background],
+        .PlayfieldLeft = ScreenPalette[indices.PlayfieldLeft],
+        .PlayfieldRight = ScreenPalette[indices.PlayfieldRight],
+        .Player0 = ScreenPalette[indices.Player0],
+        .Player1 = ScreenPalette[indices.Player1],
+    };
+}
+
+// Reverses the order of the low 20 bits
+static inline uint32_t ReverseBits20(uint32_t value)
+{
+    value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+    value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+    value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+    value = (value >> 16) | (value << 16);
+    return (value >> 12);
+}
+
+void Emulator::UpdateRenderPlayfield()
+{
+    // Left to right, PF0 is drawn from bit 4 up, PF1 from bit 7 down and PF2 from bit 0 up
+    uint32_t pf1 = PF[1];
+    pf1 = ((pf1 >> 1) & 0x55) | ((pf1 & 0x55) << 1);
+    pf1 = ((pf1 >> 2) & 0x33) | ((pf1 & 0x33) << 2);
+    pf1 = ((pf1 >> 4) & 0x0F) | ((pf1 & 0x0F) << 4);
+
+    uint32_t left = (PF[0] >> 4) | (pf1 << 4) | ((uint32_t)PF[2] << 12);
+    uint32_t right = (CTRLPF.ReflectEnabled ? ReverseBits20(left) : left);
+
+    RenderState.Playfield = left | ((uint64_t)right << 20);
+}
+
+// The latches set by each combination of objects on one pixel, as bits of Emulator::Collisions
+static constexpr std::array<word, OBJECT_MASK_COUNT> COLLISION_TABLE = []() {
+    struct CollisionLatch
+    {
+        byte First;
+        byte Second;
+    };
+
+    // D6 then D7 of each register from CXM0P up
+    constexpr CollisionLatch LATCHES[] = {
+        { OBJECT_M0, OBJECT_P0 }, { OBJECT_M0, OBJECT_P1 }, // CXM0P
+        { OBJECT_M1, OBJECT_P1 }, { OBJECT_M1, OBJECT_P0 }, // CXM1P
+        { OBJECT_P0, OBJECT_BL }, { OBJECT_P0, OBJECT_PF }, // CXP0FB
+        { OBJECT_P1, OBJECT_BL }, { OBJECT_P1, OBJECT_PF }, // CXP1FB
+        { OBJECT_M0, OBJECT_BL }, { OBJECT_M0, OBJECT_PF }, // CXM0FB
+        { OBJECT_M1, OBJECT_BL }, { OBJECT_M1, OBJECT_PF }, // CXM1FB
+        { 0, 0 }, { OBJECT_BL, OBJECT_PF }, // CXBLPF
+        { OBJECT_M0, OBJECT_M1 }, { OBJECT_P0, OBJECT_P1 }, // CXPPMM
+    };
+
+    std::array<word, OBJECT_MASK_COUNT> table = {};
+    for (unsigned objects = 0; objects < OBJECT_MASK_COUNT; ++objects) {
+        for (unsigned i = 0; i < std::size(LATCHES); ++i) {
+            const CollisionLatch& latch = LATCHES[i];
+            if (latch.First && (objects & latch.First) && (objects & latch.Second)) {
+                table[objects] |= (1 << i);
             }
         }
-        else {
-            auto draw = [&](const SDL_Color& color) {
-                ScreenBuffer[offset + 0] = color.r;
-                ScreenBuffer[offset + 1] = color.g;
-                ScreenBuffer[offset + 2] = color.b;
-            };
+    }
+
+    return table;
+}();
+
+static_assert(COLLISION_TABLE[OBJECT_P0 | OBJECT_P1] == (1 << ((ADDR_CXPPMM * 2) + 1)), "P0 and P1 set D7 of CXPPMM");
+static_assert(COLLISION_TABLE[OBJECT_BL | OBJECT_PF] == (1 << ((ADDR_CXBLPF * 2) + 1)), "BL and PF set D7 of CXBLPF");
+static_assert(COLLISION_TABLE[OBJECT_M1 | OBJECT_P1] == (1 << (ADDR_CXM1P * 2)), "M1 and P1 set D6 of CXM1P");
+static_assert(COLLISION_TABLE[OBJECT_PF] == 0, "One object can't collide");
+
+// The pixels a player covers from the start of a span, bit n for pixel n
+// It has counter pixels left to draw, from bit counter - 1 of its graphics down
+static inline uint32_t GetPlayerPixels(byte graphics, unsigned counter)
+{
+    uint32_t pixels = 0;
+    for (unsigned i = 0; i < counter; ++i) {
+        pixels |= ((graphics >> (counter - 1 - i)) & 1) << i;
+    }
 
-            const auto& colorBK = GetColor(COLUBK.Index);
-            const auto& colorPF = GetColor(COLUPF.Index);
-            const auto& colorP0 = GetColor(COLUP0.Index);
-            const auto& colorP1 = GetColor(COLUP1.Index);
+    return pixels;
+}
 
-            draw(colorBK);
+void Emulator::DetectCollisions(unsigned first, unsigned last)
+{
+    // Missiles and the ball aren't drawn, so only pixels with a player on them can have two objects
+    unsigned count = std::min(last - first, std::max(SpriteCounterP0, SpriteCounterP1));
+    if (count == 0) {
+        return;
+    }
 
-            unsigned dot = x / 4;
+    uint32_t player0 = GetPlayerPixels(GRP0, SpriteCounterP0);
+    uint32_t player1 = GetPlayerPixels(GRP1, SpriteCounterP1);
 
-            if (dot >= 20) {
-                dot -= 20;
+    // Which of the combinations of objects turned up, each looked up once at the end
+    uint64_t seen = 0;
 
-                if (CTRLPF.ReflectEnabled) {
-                    dot = 19 - dot;
-                }
-            }
+    for (unsigned i = 0; i < count; ++i) {
+        unsigned x = first + i;
 
-            unsigned bits[] = {
-                4, 5, 6, 7,
-                7, 6, 5, 4, 3, 2, 1, 0,
-                0, 1, 2, 3, 4, 5, 6, 7
-            };
+        unsigned objects = (((player0 >> i) & 1) * OBJECT_P0)
+            | (((player1 >> i) & 1) * OBJECT_P1)
+            | (((RenderState.Playfield >> (x / 4)) & 1) * OBJECT_PF);
 
+        seen |= (uint64_t)1 << objects;
+    }
 
-            // shhhh
-            unsigned byte = 0;
-            if (dot >= 4) {
-                byte = 1;
-                if (dot >= 12) {
-                    byte = 2;
-                }
-            }
+    for (; seen != 0; seen &= seen - 1) {
+        Collisions |= COLLISION_TABLE[std::countr_zero(seen)];
+    }
+}
 
-            if (PF[byte] & (1 << bits[dot])) {
-                if (CTRLPF.ScoreColorMode) {
-                    if (x > (SCREEN_WIDTH / 2)) {
-                        draw(colorP1);
-                    }
-                    else {
-                        draw(colorP0);
-                    }
-                }
-                else {
-                    draw(colorPF);
-                }
-            }
+void Emulator::DrawSpan(unsigned from, unsigned to)
+{
+    if (MemoryLine < VBLANK_CUTOFF || MemoryLine >= OVERSCAN_CUTOFF) {
+        return;
+    }
 
-            if (SpriteCounterP0 > 0) {
-                --SpriteCounterP0;
+    // Nothing is drawn during horizontal blank
+    from = std::max<unsigned>(from, HBLANK_CUTOFF);
+    if (from >= to) {
+        return;
+    }
 
-                if (GRP0 & (1 << SpriteCounterP0)) {
-                    draw(colorP0);
-                }
-            }
+    unsigned y = MemoryLine - VBLANK_CUTOFF;
+    unsigned first = from - HBLANK_CUTOFF;
+    unsigned last = to - HBLANK_CUTOFF;
 
-            if (SpriteCounterP1 > 0) {
-                --SpriteCounterP1;
+    // Objects aren't drawn during VBLANK, so they don't move along or collide either
+    if (!VBLANK.Enabled) {
+        DetectCollisions(first, last);
+    }
 
-                if (GRP1 & (1 << SpriteCounterP1)) {
-                    draw(colorP1);
-                }
-            }
+    if (ScreenOutputEnabled) {
+        if (IndexedScreenEnabled) {
+            byte * row = &IndexedScreen[y * SCREEN_WIDTH];
+            DrawPixels<byte>(row, y, first, last, RenderState.Indices, VBLANK_MAGENTA_INDEX, 0);
+        }
+        else {
+            uint32_t * row = Screen + (y * ScreenPitch);
+            DrawPixels<uint32_t>(row, y, first, last, RenderState.Colors, ScreenPalette[VBLANK_MAGENTA_INDEX], ScreenPalette[0]);
+        }
+    }
+
+    // Players count down a pixel at a time from where they were reset
+    if (!VBLANK.Enabled) {
+        unsigned width = last - first;
+        SpriteCounterP0 -= std::min(SpriteCounterP0, width);
+        SpriteCounterP1 -= std::min(SpriteCounterP1, width);
+    }
+}
 
+template <typename Pixel>
+void Emulator::DrawPixels(Pixel * row, unsigned y, unsigned first, unsigned last, const TIARenderColors<Pixel>& colors, Pixel magenta, Pixel black)
+{
+    // black holez
+    if (VBLANK.Enabled) {
+        for (unsigned x = first; x < last; ++x) {
+            bool check = (((x / 4) + (y / 4)) % 2) == 0;
+            row[x] = (check ? magenta : black);
         }
 
-        //TODO
-
-        // unsigned x = MemoryColumn - HBLANK_CUTOFF;
-        // unsigned y = MemoryLine - VBLANK_CUTOFF;
-        // unsigned offset = ((y * SCREEN_WIDTH) + x) * 3; // RGB
-
-        // //O
-        // if (x > 10 && x < 20 && y > 80 && y < 82) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 10 && x < 20 && y > 100 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 10 && x < 12 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 18 && x < 20 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // //H
-        // if (x > 24 && x < 34 && y > 90 && y < 92) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 24 && x < 26 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 32 && x < 34 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // //H
-        // if (x > 44 && x < 54 && y > 90 && y < 92) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 44 && x < 46 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 52 && x < 54 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-
-        // //I
-        // if (x > 54 && x < 64 && y > 100 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 58 && x < 60 && y > 80 && y < 102) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
-        // if (x > 54 && x < 64 && y > 80 && y < 82) {
-        // ScreenBuffer[offset + 0] = 0; // R
-        // ScreenBuffer[offset + 1] = 0; // G
-        // ScreenBuffer[offset + 2] = 0; // B
-        // break;
-        // }
+        return;
     }
 
-    ++MemoryColumn;
-    // Once we hit the end of the line
-    if (MemoryColumn == 228) {
-        MemoryColumn = 0;
-        ++MemoryLine;
+    PlayfieldColors<Pixel> playfieldColors = {
+        .Background = colors.Background,
+        .Left = colors.PlayfieldLeft,
+        .Right = colors.PlayfieldRight,
+    };
+
+    ExpandPlayfield(RenderState.Playfield, first, last, playfieldColors, row);
 
-        // Once we hit the last line
-        if (MemoryLine == 262) {
-            MemoryLine = 0;
+    // Players go over the playfield, with counter pixels left to draw from bit counter - 1 of their graphics down
+    auto drawPlayer = [&](unsigned counter, byte graphics, Pixel color) {
+        for (unsigned x = first; x < last && counter > 0; ++x) {
+            --counter;
+
+            if (graphics & (1 << counter)) {
+                row[x] = color;
+            }
         }
-    }
+    };
+
+    drawPlayer(SpriteCounterP0, GRP0, colors.Player0);
+    drawPlayer(SpriteCounterP1, GRP1, colors.Player1);
+}
+
+bool Emulator::AdvanceTIA(uint64_t clocks)
+{
+    bool wrapped = false;
+
+    while (clocks > 0) {
+        // Nothing is drawn until the next TIA write or the end of the line
+        uint64_t step = std::min<uint64_t>(clocks, 228 - MemoryColumn);
+
+        TIACycleCount += step;
+        MemoryColumn += step;
+        clocks -= step;
+
+        if (MemoryColumn == 228) {
+            DrawSpan(RenderColumn, MemoryColumn);
 
-    if (WSYNC && MemoryColumn == 0) {
-        WSYNC = false;
+            MemoryColumn = 0;
+            RenderColumn = 0;
+            ++MemoryLine;
+
+            if (MemoryLine == 262) {
+                MemoryLine = 0;
+                wrapped = true;
+            }
+
+            WSYNC = false;
+        }
     }
+
+    return wrapped;
 }
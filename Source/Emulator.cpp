@@ -4,8 +4,17 @@
 #include <cstring>
 #include <cassert>
 
-Emulator::Emulator()
+Emulator::Emulator(bool headless /*= false*/)
 {
+    SetMapper(MAPPER_NONE);
+
+    IsHeadless = headless;
+
+    if (headless) {
+        SetScreenFormat(SDL_PIXELFORMAT_ARGB8888);
+        return;
+    }
+
     SDL_Init(SDL_INIT_EVERYTHING);
 
     Window = SDL_CreateWindow(
@@ -23,8 +32,24 @@ Emulator::Emulator()
 
     SDL_RenderSetVSync(Renderer, 1);
 
+    // The renderer lists the formats it takes best first, any 32-bit one can be drawn straight into
+    uint32_t format = SDL_PIXELFORMAT_ARGB8888;
+
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(Renderer, &info) == 0) {
+        for (uint32_t i = 0; i < info.num_texture_formats; ++i) {
+            uint32_t candidate = info.texture_formats[i];
+            if (!SDL_ISPIXELFORMAT_FOURCC(candidate) && SDL_BYTESPERPIXEL(candidate) == 4) {
+                format = candidate;
+                break;
+            }
+        }
+    }
+
+    SetScreenFormat(format);
+
     ScreenTexture = SDL_CreateTexture(Renderer,
-        SDL_PIXELFORMAT_RGB24,
+        format,
         SDL_TEXTUREACCESS_STREAMING,
         SCREEN_WIDTH,
         SCREEN_HEIGHT
@@ -33,11 +58,24 @@ Emulator::Emulator()
 
 Emulator::~Emulator()
 {
+#if defined(FREYA2600_BUS_DIAGNOSTICS)
+    Diagnostics.Dump(stdout);
+#endif
+
     if (Debug) {
         delete Debug;
         Debug = nullptr;
     }
 
+#if defined(FREYA2600_JIT)
+    FreeNativeCode();
+#endif
+
+    // SDL was never started, and other headless instances may be using it on other threads
+    if (IsHeadless) {
+        return;
+    }
+
     SDL_DestroyTexture(ScreenTexture);
     ScreenTexture = nullptr;
 
@@ -63,6 +101,12 @@ void Emulator::Reset()
     
     if (Debug) {
         Debug->Disassemble(PC);
+
+        // Code that was only found last time once it ran
+        for (unsigned i = 0; i < Metadata.RootCount; ++i) {
+            Debug->Disassemble(Metadata.Roots[i], true);
+        }
+
         // Debug->PrintDisassembly();
     }
 
@@ -70,7 +114,7 @@ void Emulator::Reset()
     A = 0x00;
     X = 0x00;
     Y = 0x00;
-    SR = 0x00;
+    WriteSR(0x00);
 
     INTIM = 0x00;
     TIMINT._raw = 0x00;
@@ -99,6 +143,11 @@ void Emulator::Reset()
     PF[1] = 0x00;
     PF[2] = 0x00;
 
+    UpdateRenderColors();
+    UpdateRenderPlayfield();
+
+    Collisions = 0;
+
     AUDC0._raw = 0x00;
     AUDC1._raw = 0x00;
     AUDF0._raw = 0x00;
@@ -136,42 +185,50 @@ void Emulator::Reset()
 
     // Initial version used $FF, all subsequent versions use $00
     memset(RAM, 0x00, sizeof(RAM));
+    memset(EXTRAM, 0x00, sizeof(EXTRAM));
 
-    ROMBank = 0;
+    // All of it changed
+    memset(DirtyLines, 0xFF, sizeof(DirtyLines));
 
-    // TODO: EXTRAM ?
+    // Back to the banks the cartridge powers on with
+    MapMemory();
 
     CPUCycleCount = 0;
     TIACycleCount = 0;
+    InstructionCount = 0;
+
+    // Leave the test pattern alone until the TIA draws over it
+    RenderColumn = MemoryColumn;
 
     // Official Test Pattern ;) 
+    uint32_t blue = MapScreenColor(91, 206, 250);
+    uint32_t pink = MapScreenColor(245, 169, 184);
+    uint32_t white = MapScreenColor(255, 255, 255);
+
     for (unsigned y = 0; y < SCREEN_HEIGHT; ++y) {
         for (unsigned x = 0; x < SCREEN_WIDTH; ++x) {
-            unsigned offset = ((y * SCREEN_WIDTH) + x) * 3; // RGB
+            unsigned offset = (y * SCREEN_WIDTH) + x;
             if (y < 38 || y > 154) {
-                ScreenBuffer[offset + 0] = 91; // R
-                ScreenBuffer[offset + 1] = 206; // G
-                ScreenBuffer[offset + 2] = 250; // B
+                ScreenBuffer[offset] = blue;
             }
             else if (y < 76 || y > 116) {
-                ScreenBuffer[offset + 0] = 245; // R
-                ScreenBuffer[offset + 1] = 169; // G
-                ScreenBuffer[offset + 2] = 184; // B
+                ScreenBuffer[offset] = pink;
             }
             else {
-                ScreenBuffer[offset + 0] = 255; // R
-                ScreenBuffer[offset + 1] = 255; // G
-                ScreenBuffer[offset + 2] = 255; // B
+                ScreenBuffer[offset] = white;
             }
         }
     }
+
+    // The pattern isn't in the palette
+    memset(IndexedScreen, 0, sizeof(IndexedScreen));
 }
 
 void Emulator::LoadCartridge(const char * filename)
 {
     //Try to open file
-    FILE* file = fopen(filename, "rb");
-    if (file == nullptr) {
+    auto image = ROMImage::Load(filename);
+    if (!image) {
         printf("Failed to open ROM file: %s\n", filename);
         return;
     }
@@ -179,35 +236,112 @@ void Emulator::LoadCartridge(const char * filename)
     //Set Windows Title
     char title[1024];
     snprintf(title,sizeof(title),"Freya2600 - %s",filename);
-    SDL_SetWindowTitle(Window,title);
+    if (Window) {
+        SDL_SetWindowTitle(Window,title);
+    }
 
     printTraceLogHeaders(filename);
 
-    // Determine the ROM file size
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    // Calculate the number of ROM banks
-    int numBanks = fileSize / ROM_BANK_SIZE;
-    if (numBanks > MAX_BANKS) {
+    if (image->BankCount > MAX_BANKS) {
         printf("'%s' is not a valid Atari 2600 ROM, the file is too large.\n", filename);
         exit(1);
     }
 
-    // Read the ROM file into memory
-    fileSize = std::min(fileSize, (long)sizeof(ROM));
-    fread(&ROM[0][0x0000], 1, fileSize, file);
-
-    // Deal with undersized ROMs
-    if (fileSize == ROM_HALF_BANK_SIZE) {
-        memcpy(&ROM[0][ROM_HALF_BANK_SIZE], &ROM[0][0x0000], ROM_HALF_BANK_SIZE);
-    }
+    // Calculate the number of ROM banks
+    int numBanks = image->Size / ROM_BANK_SIZE;
 
-    fclose(file);
+    bool cached = InsertCartridge(std::move(image));
 
     printf("ROM file loaded successfully.\n");
     printf("Number of ROM banks: %d\n", numBanks);
+    printf("Bank switching: %s%s\n", Mapper->Name, (cached ? " (cached)" : ""));
+}
+
+bool Emulator::InsertCartridge(std::shared_ptr<const ROMImage> image)
+{
+    assert(image && image->BankCount <= MAX_BANKS);
+
+    Cartridge = std::move(image);
+
+    ROM = (const byte (*)[ROM_BANK_SIZE])Cartridge->Data;
+    ROMBankCount = Cartridge->BankCount;
+    ROMSize = Cartridge->Size;
+
+    InvalidateBlockCache();
+
+    // Blocks recompiled for the last cartridge don't apply to this one
+    for (auto& blocks : RecompiledBlocks) {
+        blocks.clear();
+    }
+
+    if (ROMCacheFilename) {
+        MetadataCache.Open(ROMCacheFilename);
+    }
+
+    const ROMMetadata * cached = MetadataCache.Find(Cartridge->Hash, ROMSize);
+    if (cached && cached->MapperType < MAPPER_COUNT) {
+        Metadata = *cached;
+        SetMapper(Metadata.MapperType);
+    }
+    else {
+        SetMapper(DetectMapper());
+
+        Metadata = {};
+        Metadata.Hash = Cartridge->Hash;
+        Metadata.Size = ROMSize;
+        Metadata.MapperType = MapperType;
+        Metadata.Entrypoint = PeekWord(0xFFFC);
+        MetadataCache.Store(Metadata);
+    }
+
+    return (cached != nullptr);
+}
+
+void Emulator::AddDisassemblyRoot(word address)
+{
+    if (!Cartridge || Metadata.RootCount >= ROM_METADATA_MAX_ROOTS) {
+        return;
+    }
+
+    for (unsigned i = 0; i < Metadata.RootCount; ++i) {
+        if (Metadata.Roots[i] == address) {
+            return;
+        }
+    }
+
+    Metadata.Roots[Metadata.RootCount++] = address;
+    MetadataCache.Store(Metadata);
+}
+
+void Emulator::UseRecompiledBlocks(uint64_t romHash, const RecompiledBlockEntry * entries, size_t count)
+{
+    if (romHash != HashROM()) {
+        printf("Recompiled blocks were built for a different ROM, using the interpreter\n");
+        return;
+    }
+
+    // Blocks are looked up by bank, which doesn't say what's mapped where when less than a whole bank switches
+    // FE reads all of its ROM through the mapper rather than the memory map, so RunBlock never gets to them
+    if (Mapper->SliceSize != ROM_BANK_SIZE || MapperType == MAPPER_FE) {
+        printf("Recompiled blocks aren't supported with %s bank switching, using the interpreter\n", Mapper->Name);
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const auto& entry = entries[i];
+        if (entry.Bank >= MAX_BANKS || entry.Offset >= ROM_BANK_SIZE) {
+            continue;
+        }
+
+        auto& blocks = RecompiledBlocks[entry.Bank];
+        if (blocks.empty()) {
+            blocks.resize(ROM_BANK_SIZE);
+        }
+
+        blocks[entry.Offset] = entry.Function;
+    }
+
+    printf("Using %zu recompiled blocks\n", count);
 }
 
 void Emulator::Run()
@@ -250,18 +384,22 @@ void Emulator::Run()
             // TODO: Input
         }
 
-        if (IsPlaying) {
+        // A whole frame is drawn straight into the texture
+        // Stepping in the debugger or running up to a breakpoint draws into ScreenBuffer instead, as either can stop anywhere in a frame
+        bool canStop = (Debug && Debug->Breakpoint != UINT_MAX);
+        if (IsPlaying && !canStop && !IndexedScreenEnabled && LockScreen()) {
             DoFrame();
+            FlushTIA();
+            UnlockScreen();
         }
-        
-        int pitch;
-        uint8_t * pixels = nullptr;
-        SDL_LockTexture(ScreenTexture, nullptr, (void **)&pixels, &pitch);
-        {
-            assert(pitch != 0);
-            memcpy(pixels, ScreenBuffer, SCREEN_BUFFER_SIZE);
+        else {
+            if (IsPlaying) {
+                DoFrame();
+            }
+
+            FlushTIA();
+            CopyScreenBuffer();
         }
-        SDL_UnlockTexture(ScreenTexture);
 
         SDL_SetRenderDrawColor(Renderer, 0, 0, 0, 255);
         SDL_RenderClear(Renderer);
@@ -294,22 +432,72 @@ void Emulator::Run()
     
 }
 
+bool Emulator::LockScreen()
+{
+    int pitch;
+    void * pixels = nullptr;
+    if (SDL_LockTexture(ScreenTexture, nullptr, &pixels, &pitch) < 0) {
+        return false;
+    }
+
+    assert(pitch != 0);
+
+    Screen = (uint32_t *)pixels;
+    ScreenPitch = pitch / sizeof(uint32_t);
+    return true;
+}
+
+void Emulator::UnlockScreen()
+{
+    SDL_UnlockTexture(ScreenTexture);
+
+    Screen = ScreenBuffer;
+    ScreenPitch = SCREEN_WIDTH;
+}
+
+void Emulator::CopyScreenBuffer()
+{
+    int pitch;
+    uint8_t * pixels = nullptr;
+    if (SDL_LockTexture(ScreenTexture, nullptr, (void **)&pixels, &pitch) < 0) {
+        return;
+    }
+
+    assert(pitch != 0);
+
+    for (unsigned y = 0; y < SCREEN_HEIGHT; ++y) {
+        uint32_t * row = (uint32_t *)(pixels + (y * pitch));
+
+        if (IndexedScreenEnabled) {
+            const byte * indices = &IndexedScreen[y * SCREEN_WIDTH];
+            for (unsigned x = 0; x < SCREEN_WIDTH; ++x) {
+                row[x] = ScreenPalette[indices[x]];
+            }
+        }
+        else {
+            memcpy(row, &ScreenBuffer[y * SCREEN_WIDTH], SCREEN_WIDTH * sizeof(uint32_t));
+        }
+    }
+
+    SDL_UnlockTexture(ScreenTexture);
+}
+
 void Emulator::DoStep()
 {
     do {
         uint64_t beforeInstCycles = CPUCycleCount;
         
-        TickCPU();
+        if (WSYNC) {
+            SkipWSYNC();
+        }
+        else {
+            TickCPU();
+        }
 
         uint64_t deltaInstCycles = CPUCycleCount - beforeInstCycles;
 
-        for (uint64_t i = 0; i < deltaInstCycles; ++i) {
-            TickPIA();
-        }
-
-        for (uint64_t i = 0; i < deltaInstCycles * 3; ++i) {
-            TickTIA();
-        }   
+        AdvancePIA(deltaInstCycles);
+        AdvanceTIA(deltaInstCycles * 3);
     }
     while (WSYNC);
 }
@@ -321,22 +509,24 @@ void Emulator::DoLine()
 
         uint64_t beforeInstCycles = CPUCycleCount;
         
-        TickCPU();
+        if (WSYNC) {
+            SkipWSYNC();
+        }
+        else {
+            TickCPU();
+        }
 
         uint64_t deltaInstCycles = CPUCycleCount - beforeInstCycles;
 
-        for (uint64_t i = 0; i < deltaInstCycles; ++i) {
-            TickPIA();
-        }
+        AdvancePIA(deltaInstCycles);
 
-        for (uint64_t i = 0; i < deltaInstCycles * 3; ++i) {
-            unsigned lastMemoryLine = MemoryLine;
+        // Neither an instruction nor WSYNC can take more than one line
+        unsigned lastMemoryLine = MemoryLine;
 
-            TickTIA();
+        AdvanceTIA(deltaInstCycles * 3);
 
-            if (MemoryLine != lastMemoryLine) {
-                IsDrawing = false;
-            }
+        if (MemoryLine != lastMemoryLine) {
+            IsDrawing = false;
         }
     }
 }
@@ -346,28 +536,57 @@ void Emulator::DoFrame()
     IsDrawing = true;
     while (IsDrawing) {
 
+        // The fast paths have no WSYNC or breakpoint checks, so they only run without either
+        if (!WSYNC && (!Debug || Debug->Breakpoint == UINT_MAX)) {
+            // Polling INTIM does nothing but wait on the timer
+            if (IdleLoopSkipEnabled && SkipIdleLoop(PC) > 0) {
+                continue;
+            }
+
+#if defined(FREYA2600_THREADED_INTERPRETER)
+            RunThreaded();
+            continue;
+#else
+            if (BlockCacheEnabled && RunBlock()) {
+                continue;
+            }
+#endif
+        }
+
+        if (WSYNC) {
+            TickFramePeripherals(SkipWSYNC());
+            continue;
+        }
+
         uint64_t beforeInstCycles = CPUCycleCount;
         
         TickCPU();
 
         uint64_t deltaInstCycles = CPUCycleCount - beforeInstCycles;
 
-        for (uint64_t i = 0; i < deltaInstCycles; ++i) {
-            TickPIA();
-        }
-
-        for (uint64_t i = 0; i < deltaInstCycles * 3; ++i) {
-            unsigned lastMemoryLine = MemoryLine;
+        TickFramePeripherals(deltaInstCycles);
+    }
+}
 
-            TickTIA();
+void Emulator::TickFramePeripherals(uint64_t cycles)
+{
+    AdvancePIA(cycles);
 
-            if (MemoryLine == 0 && MemoryLine != lastMemoryLine) {
-                IsDrawing = false;
-            }
-        }
+    if (AdvanceTIA(cycles * 3)) {
+        IsDrawing = false;
     }
 }
 
+uint64_t Emulator::SkipWSYNC()
+{
+    // The CPU is released once the TIA wraps to the start of the next line, checked every 3 color clocks
+    uint64_t cycles = (228 - MemoryColumn + 2) / 3;
+
+    CPUCycleCount += cycles;
+
+    return cycles;
+}
+
 void Emulator::printRAMGrid(const uint8_t* RAM) {
     // Print top column names
     printf("    ");
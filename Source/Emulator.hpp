@@ -3,13 +3,22 @@
 
 #include <Config.hpp>
 #include <Constants.hpp>
+#include <Types/Cartridge.hpp>
 #include <Types/CPU.hpp>
+#include <Types/Memory.hpp>
 #include <Types/PIA.hpp>
+#include <Types/Snapshot.hpp>
 #include <Types/TIA.hpp>
 
 #include <SDL.h>
 
+#include <memory>
+#include <vector>
+
+#include "BusDiagnostics.hpp"
 #include "Debugger.hpp"
+#include "ROMCache.hpp"
+#include "ROMImage.hpp"
 
 class Emulator
 {
@@ -64,6 +73,11 @@ public:
         byte SR;
     };
 
+    // N and Z are set by nearly every instruction but rarely read, so instead of updating SR the
+    // values they come from are kept, N is bit 7 of FlagResultN and Z is set when FlagResultZ is 0
+    byte FlagResultN = 0;
+    word FlagResultZ = 1;
+
     ///
     /// RAM I/O Timer / RIOT
     /// Peripheral Interface Adaptor / PIA
@@ -129,6 +143,11 @@ public:
 
     byte PF[3];
 
+    TIARenderState RenderState = {};
+
+    // The collision latches, D7 and D6 of CXM0P to CXPPMM two bits at a time
+    word Collisions = 0;
+
     AudioControl AUDC0;
 
     AudioControl AUDC1;
@@ -176,14 +195,93 @@ public:
     /// Cartridge
     ///
 
-    byte ROM[MAX_BANKS][ROM_BANK_SIZE];
+    // The loaded cartridge, usually mapped straight from the file and shared with every other emulator running it
+    std::shared_ptr<const ROMImage> Cartridge;
+
+    // The banks of Cartridge, or one blank bank before anything is loaded
+    const byte (*ROM)[ROM_BANK_SIZE] = BLANK_ROM;
+
+    size_t ROMBankCount = 1;
+
+    // currently selected bank of ROM, mappers that switch smaller slices pack all of their selections in here
+    // so that anything watching for a bank switch sees every change to the mapping
+    int ROMBank = 0;
+
+    // Every page of the address space, pointing straight at RAM and the current bank of ROM
+    MemoryPage MemoryMap[MEMORY_PAGE_COUNT];
+
+    size_t ROMSize = 0; // bytes of ROM loaded from the cartridge
+
+    byte MapperType = MAPPER_NONE;
+
+    const MapperInfo * Mapper;
+
+    // Slice selected for each slot, for mappers that switch less than a whole bank
+    unsigned MapperSlots[4] = {};
+
+    byte EXTRAM[0x800];
+
+    ///
+    /// Dirty Lines
+    ///
+
+    // A bit per DIRTY_LINE_SIZE bytes of memory written since they were last cleared
+    // The first byte is RAM, and each byte after it a page of EXTRAM
+    byte DirtyLines[(sizeof(RAM) + sizeof(EXTRAM)) / MEMORY_PAGE_SIZE] = {};
+
+    ///
+    /// Block Cache
+    ///
+
+    // Decoded blocks, indexed by offset into the bank, allocated the first time the bank runs
+    std::vector<std::unique_ptr<DecodedBlock>> BlockCache[MAX_BANKS];
+
+    bool BlockCacheEnabled = true;
+
+    // Whether blocks are decoded with superinstructions, takes effect for blocks decoded after it changes
+    bool FusionEnabled = true;
+
+    // Number of times each kind of superinstruction has run, indexed by FUSION_*
+    uintmax_t FusionCounts[FUSION_COUNT] = {};
+
+    // Functions for the blocks compiled ahead of time, indexed by offset into the bank
+    std::vector<RecompiledBlock> RecompiledBlocks[MAX_BANKS];
+
+    ///
+    /// Idle Loops
+    ///
+
+    bool IdleLoopSkipEnabled = true;
+
+    // Instructions of INTIM polling loops that were skipped over instead of run, also counted in InstructionCount
+    uintmax_t IdleInstructionCount = 0;
+
+#if defined(FREYA2600_BUS_DIAGNOSTICS)
+    ///
+    /// Bus Diagnostics
+    ///
+
+    // Reads and writes that did nothing, dumped when the emulator is destroyed
+    BusDiagnostics Diagnostics;
+#endif
+
+#if defined(FREYA2600_JIT)
+    ///
+    /// JIT
+    ///
+
+    bool JITEnabled = true;
 
-    int ROMBank = 0; // currently selected bank of ROM
+    // Executable memory for translated blocks, mapped the first time a block gets hot
+    byte * JITCode = nullptr;
 
-    byte EXTRAM[0x100];
+    // Bytes of JITCode in use
+    size_t JITCodeUsed = 0;
+#endif
     
     bool IsPlaying;
     bool IsDrawing;
+    bool IsHeadless = false;
 
     SDL_Window * Window = nullptr;
 
@@ -198,23 +296,58 @@ public:
 
     SDL_Texture * ScreenTexture = nullptr;
 
-    uint8_t ScreenBuffer[SCREEN_BUFFER_SIZE];
+    // The format of ScreenTexture, the renderer's own so the driver doesn't have to convert it
+    uint32_t ScreenFormat = SDL_PIXELFORMAT_UNKNOWN;
+
+    // Red, green, blue and alpha bits of ScreenFormat
+    // Colors are packed by hand, SDL_MapRGB would need an SDL_PixelFormat from SDL's shared cache
+    uint32_t ScreenMasks[4] = {};
+
+    // The NTSC palette in ScreenFormat, then VBLANK_MAGENTA_INDEX
+    // The rest is black, so any byte of IndexedScreen can be looked up
+    uint32_t ScreenPalette[256];
+
+    // Frames drawn without the texture locked, when headless or stepping in the debugger
+    uint32_t ScreenBuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+
+    // Draw palette indices into IndexedScreen instead of colors into Screen
+    // Colors are then only looked up when the frame is shown, and never for anything that just compares or hashes frames
+    bool IndexedScreenEnabled = false;
+
+    // Indices into ScreenPalette, one byte per pixel
+    byte IndexedScreen[SCREEN_WIDTH * SCREEN_HEIGHT] = {};
+
+    // Draw pixels at all, the TIA still works out collisions without them
+    bool ScreenOutputEnabled = true;
+
+    // Where the TIA draws, the locked ScreenTexture while a frame plays and ScreenBuffer otherwise
+    uint32_t * Screen = ScreenBuffer;
+
+    // In pixels
+    size_t ScreenPitch = SCREEN_WIDTH;
 
     unsigned MemoryLine = 0;
 
     unsigned MemoryColumn = 0;
 
+    // The current line has been drawn up to here, the rest is drawn at the next TIA write or the end of the line
+    unsigned RenderColumn = 0;
+
     uintmax_t CPUCycleCount = 0;
 
     uintmax_t TIACycleCount = 0;
 
+    uintmax_t InstructionCount = 0;
+
     uintmax_t FrameCount = 0;
 
     Debugger * Debug = nullptr;
 
     FILE* tLog;
 
-    Emulator();
+    // Headless instances skip the window and renderer, for tools and batch runs
+    // They never touch SDL's global state, so they can be created and destroyed on any thread
+    Emulator(bool headless = false);
 
     ~Emulator();
 
@@ -224,6 +357,22 @@ public:
 
     void LoadCartridge(const char * filename);
 
+    // Runs an image that is already loaded, so any number of emulators can share one copy of the ROM
+    // Returns true if Metadata came from MetadataCache rather than being worked out again
+    bool InsertCartridge(std::shared_ptr<const ROMImage> image);
+
+    // Where metadata about every ROM that has been loaded is kept, or nullptr to always work it out again
+    // Off unless asked for, so tools don't leave a cache in whatever directory they're run from
+    const char * ROMCacheFilename = nullptr;
+
+    ROMCache MetadataCache;
+
+    // Metadata for the loaded cartridge, from the cache or from detecting it
+    ROMMetadata Metadata = {};
+
+    // Remembers an address that code was found at, so it is disassembled up front next time
+    void AddDisassemblyRoot(word address);
+
     void Run();
 
     void DoStep();
@@ -232,26 +381,244 @@ public:
 
     void DoFrame();
 
+    // Runs the PIA and TIA for the cycles of one instruction, ending the frame when the TIA wraps to line 0
+    void TickFramePeripherals(uint64_t cycles);
+
+    // Spends the cycles the CPU is halted by WSYNC all at once, returns how many cycles that was
+    uint64_t SkipWSYNC();
+
+#if defined(FREYA2600_THREADED_INTERPRETER)
+    // Runs instructions for DoFrame until WSYNC is set or the frame ends, dispatching with computed gotos
+    void RunThreaded();
+#endif
+
     void TickCPU();
 
-    void TickTIA();
+    // Runs the cached block at PC for DoFrame, returns false if PC is not in ROM
+    bool RunBlock();
+
+    // Runs one instruction of a cached block for DoFrame, returns false once the rest of the block can't run
+    bool StepDecoded(const DecodedInstruction& inst, int bank);
+
+    // Runs the superinstruction starting at inst for DoFrame, returns false once the rest of the block can't run
+    bool StepFused(const DecodedInstruction * inst, int bank);
+
+    DecodedBlock * GetBlock(unsigned bank, word offset);
+
+    // Marks the instructions of a freshly decoded block that can run as superinstructions
+    void FuseInstructions(DecodedBlock * block);
+
+    // Runs an LDA INTIM polling loop at pc in one go, up to the read that leaves it or the end of the frame
+    // Returns the number of cycles skipped, which the PIA and TIA have already been advanced for
+    uint64_t SkipIdleLoop(word pc);
+
+    void InvalidateBlockCache();
+
+#if defined(FREYA2600_JIT)
+    // Runs a block as native code once it is hot, returns false if it didn't run any instructions
+    bool RunNative(DecodedBlock * block);
+
+    // Translates a block to x86-64, returns false if there is no room left for it
+    bool CompileBlock(DecodedBlock * block);
+
+    // Drops every translated block, leaving the decoded blocks to be counted up again
+    void InvalidateNativeCode();
+
+    void FreeNativeCode();
+#endif
+
+    // Fetches the operand of an instruction and runs it, specialized per opcode
+    template <byte Opcode>
+    void Execute();
+
+    // Runs an instruction whose operand has already been fetched
+    template <byte Opcode>
+    void Operate(word operand);
+
+    // Runs one instruction of a recompiled block for DoFrame, returns false once the rest of the block can't run
+    template <byte Opcode>
+    bool RunInstruction(word operand, int bank);
+
+    // Replaces the decoding of any block in the table with its recompiled function, if romHash matches the cartridge
+    void UseRecompiledBlocks(uint64_t romHash, const RecompiledBlockEntry * entries, size_t count);
+
+    // FNV-1a hash of the cartridge, used to match recompiled blocks to the ROM they were built from
+    uint64_t HashROM() {
+        return (Cartridge ? Cartridge->Hash : 0);
+    }
+
+    // Draws the current line from column from up to column to, as the TIA registers are now
+    void DrawSpan(unsigned from, unsigned to);
+
+    // Latches the collisions between objects over pixels first to last - 1 of the current line
+    void DetectCollisions(unsigned first, unsigned last);
+
+    // Draws pixels first to last - 1 of line y for DrawSpan, as colors or palette indices
+    template <typename Pixel>
+    void DrawPixels(Pixel * row, unsigned y, unsigned first, unsigned last, const TIARenderColors<Pixel>& colors, Pixel magenta, Pixel black);
+
+    // Draws everything up to the current color clock, before a TIA register changes or the screen is shown
+    inline void FlushTIA() {
+        if (MemoryColumn > RenderColumn) {
+            DrawSpan(RenderColumn, MemoryColumn);
+        }
+
+        RenderColumn = MemoryColumn;
+    }
+
+    // Runs the TIA for a number of color clocks, drawing each line once it ends
+    // Returns true if the TIA wrapped back to line 0
+    bool AdvanceTIA(uint64_t clocks);
 
     void TickPIA();
 
-    byte ReadByte(word address, bool tick = true);
+    // Runs the PIA for a number of cycles, a timer interval at a time
+    void AdvancePIA(uint64_t cycles);
+
+    // Sets up MemoryMap, called once RAM and ROM are in place
+    void MapMemory();
+
+    // Points every page in address to address + size at read and write, offset by the page
+    void MapPages(word address, size_t size, const byte * read, byte * write, byte handler);
+
+    // The byte of DirtyLines for a page of RAM or EXTRAM
+    byte * GetDirtyLines(const byte * memory);
+
+    // For consumers of DirtyLines, once they have caught up with every write
+    void ClearDirtyLines();
+
+    inline bool IsRAMLineDirty(word offset) const {
+        return DirtyLines[0] & (1 << ((offset & 0x7F) >> DIRTY_LINE_SHIFT));
+    }
+
+    inline bool IsEXTRAMLineDirty(word offset) const {
+        offset &= (sizeof(EXTRAM) - 1);
+        return DirtyLines[1 + (offset / MEMORY_PAGE_SIZE)] & (1 << ((offset & (MEMORY_PAGE_SIZE - 1)) >> DIRTY_LINE_SHIFT));
+    }
+
+    // Switches banks, pointing the ROM pages at the new bank
+    void SetROMBank(int bank);
+
+    // Switches to one of MAPPER_*, and remaps memory for it
+    void SetMapper(byte type);
+
+    // The most likely bank switching scheme for the loaded ROM, see DetectMappers
+    byte DetectMapper();
+
+    inline byte ReadByte(word address, bool tick = true) {
+        if (tick) {
+            ++CPUCycleCount;
+        }
+
+        const MemoryPage& page = MemoryMap[(address & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+        if (page.Read) {
+            return page.Read[address & (MEMORY_PAGE_SIZE - 1)];
+        }
+
+        return ReadIO(address, tick);
+    }
+
+    inline void WriteByte(word address, byte data) {
+        ++CPUCycleCount;
+
+        const MemoryPage& page = MemoryMap[(address & ADDRESS_MASK) >> MEMORY_PAGE_SHIFT];
+        if (page.Write) {
+            word offset = address & (MEMORY_PAGE_SIZE - 1);
+            page.Write[offset] = data;
+            *page.Dirty |= (1 << (offset >> DIRTY_LINE_SHIFT));
+            return;
+        }
+
+        WriteIO(address, data);
+    }
+
+    // Reads and writes for the pages with no memory behind them, by their Handler
+    // The address is passed on unmasked, as some mappers look at the lines above A12
+    byte ReadIO(word address, bool tick);
+
+    void WriteIO(word address, byte data);
+
+    byte ReadTIA(word address);
+
+    byte ReadRIOT(word address);
+
+    // What ReadTIA and ReadRIOT would return, without clearing anything
+    byte PeekTIA(word address) const;
+
+    byte PeekRIOT(word address) const;
+
+    // Reads for tools and the debugger, which never tick, switch banks or clear flags
+    byte Peek(word address) const;
+
+    inline word PeekWord(word address) const {
+        return (Peek(address + 1) << 8) | Peek(address);
+    }
+
+    // Peeks size bytes starting at address into buffer, a page at a time where there's memory behind it
+    void PeekRange(word address, size_t size, byte * buffer) const;
+
+    // Copies the CPU, RAM, RIOT and TIA registers out all at once
+    void TakeSnapshot(MachineSnapshot * snapshot) const;
 
-    void WriteByte(word address, byte data);
+    void WriteRIOT(word address, byte data);
+
+    // Writes one TIA register, specialized so stores can be resolved ahead of time
+    template <byte Register>
+    void WriteTIA(byte data);
+
+    // The WriteTIA for an address, or nullptr if it isn't a TIA register
+    TIAWriteHandler GetTIAWrite(word address);
 
     // const char * Disassemble(word address);
 
     SDL_Color GetColor(uint8_t index);
 
+    // Sets ScreenFormat to one of SDL_PIXELFORMAT_*, and fills ScreenPalette in it
+    void SetScreenFormat(uint32_t format);
+
+    // A fully opaque color in ScreenFormat
+    uint32_t MapScreenColor(byte r, byte g, byte b) const;
+
+    // Points Screen at ScreenTexture for a whole frame to be drawn into, returns false if it can't be locked
+    // What was in the texture is lost, so everything shown has to be drawn again before UnlockScreen
+    bool LockScreen();
+
+    // Points Screen back at ScreenBuffer, and leaves the texture with the frame drawn into it
+    void UnlockScreen();
+
+    // Shows ScreenBuffer or IndexedScreen, for frames drawn without the texture locked
+    void CopyScreenBuffer();
+
+    // Brings RenderState up to date after a write to COLUxx or CTRLPF
+    void UpdateRenderColors();
+
+    // Brings RenderState up to date after a write to PF0-2 or CTRLPF
+    void UpdateRenderPlayfield();
+
     void printRAMGrid(const uint8_t* RAM);
 
     void printTraceLogHeaders(const char* filename);
 
     // void printRegisters();
 
+    // Brings N and Z in SR up to date, for anything that reads SR as a whole
+    inline byte ReadSR() {
+        N = (FlagResultN >> 7);
+        Z = (FlagResultZ == 0);
+        return SR;
+    }
+
+    // SR with N and Z brought up to date, without writing them back
+    inline byte PeekSR() const {
+        return (SR & 0x7D) | (FlagResultN & 0x80) | (FlagResultZ == 0 ? 0x02 : 0x00);
+    }
+
+    inline void WriteSR(byte data) {
+        SR = data;
+        FlagResultN = (N << 7);
+        FlagResultZ = !Z;
+    }
+
     inline byte NextByte() {
         return ReadByte(PC++);
     }
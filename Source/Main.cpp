@@ -2,6 +2,11 @@
 
 #include <thread>
 #include <cstdio>
+#include <cstring>
+
+#if defined(FREYA2600_RECOMPILED)
+    #include "Recompiled.hpp"
+#endif
 
 int main(int argc, char * argv[])
 {
@@ -9,12 +14,22 @@ int main(int argc, char * argv[])
 
     emu->StartDebugger();
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s ROM_FILENAME\n", argv[0]);
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--cache") == 0) {
+        emu->ROMCacheFilename = argv[arg + 1];
+        arg += 2;
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [--cache CACHE_FILENAME] ROM_FILENAME\n", argv[0]);
         return 1;
     }
 
-    emu->LoadCartridge(argv[1]);
+    emu->LoadCartridge(argv[arg]);
+
+#if defined(FREYA2600_RECOMPILED)
+    emu->UseRecompiledBlocks(RECOMPILED_ROM_HASH, RECOMPILED_BLOCKS, RECOMPILED_BLOCK_COUNT);
+#endif
     
     emu->Run();
 
@@ -0,0 +1,444 @@
+#include "MapperDetection.hpp"
+#include "Constants.hpp"
+#include "CPUFeatures.hpp"
+
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <initializer_list>
+
+///
+/// Signatures
+///
+
+// What the code a signature picks out says about the mapper
+constexpr byte SIGNATURE_3F = 0; // STA $3F
+constexpr byte SIGNATURE_E0 = 1; // E0 slice selection
+constexpr byte SIGNATURE_E7 = 2; // E7 slice and RAM bank selection
+constexpr byte SIGNATURE_FE = 3; // Activision JSRs into the other bank
+constexpr byte SIGNATURE_F8 = 4; // 1FF8 and 1FF9, the hotspots every F8, F6 and F4 game has
+constexpr byte SIGNATURE_F6 = 5; // 1FF6 and 1FF7, only F6 and F4 have them
+constexpr byte SIGNATURE_F4 = 6; // 1FF4, 1FF5, 1FFA and 1FFB, only F4 has them
+
+constexpr size_t SIGNATURE_GROUP_COUNT = 7;
+
+constexpr size_t SIGNATURE_MAX_LENGTH = 5;
+
+struct MapperSignature
+{
+    byte Bytes[SIGNATURE_MAX_LENGTH];
+
+    byte Length;
+
+    // One of SIGNATURE_*
+    byte Group;
+
+}; // struct MapperSignature
+
+struct MapperSignatureTable
+{
+    MapperSignature Entries[96];
+
+    size_t Count;
+
+}; // struct MapperSignatureTable
+
+static constexpr MapperSignatureTable SIGNATURES = []() {
+    MapperSignatureTable table = {};
+
+    auto add = [&](byte group, std::initializer_list<byte> bytes) {
+        MapperSignature& signature = table.Entries[table.Count++];
+        for (byte b : bytes) {
+            signature.Bytes[signature.Length++] = b;
+        }
+        signature.Group = group;
+    };
+
+    // LDA, STA and BIT of a hotspot, through the two mirrors nearly every game uses
+    auto addHotspots = [&](byte group, std::initializer_list<word> hotspots) {
+        for (word hotspot : hotspots) {
+            for (byte opcode : { 0xAD, 0x8D, 0x2C }) {
+                add(group, { opcode, byte(hotspot & 0xFF), 0x1F });
+                add(group, { opcode, byte(hotspot & 0xFF), 0xFF });
+            }
+        }
+    };
+
+    add(SIGNATURE_3F, { 0x85, 0x3F }); // STA $3F
+
+    add(SIGNATURE_E0, { 0x8D, 0xE0, 0x1F }); // STA $1FE0
+    add(SIGNATURE_E0, { 0x8D, 0xE0, 0x5F }); // STA $5FE0
+    add(SIGNATURE_E0, { 0x8D, 0xE9, 0xFF }); // STA $FFE9
+    add(SIGNATURE_E0, { 0x0C, 0xE0, 0x1F }); // NOP $1FE0
+    add(SIGNATURE_E0, { 0xAD, 0xE0, 0x1F }); // LDA $1FE0
+    add(SIGNATURE_E0, { 0xAD, 0xE9, 0xFF }); // LDA $FFE9
+    add(SIGNATURE_E0, { 0xAD, 0xED, 0xFF }); // LDA $FFED
+    add(SIGNATURE_E0, { 0xAD, 0xF3, 0xBF }); // LDA $BFF3
+
+    add(SIGNATURE_E7, { 0xAD, 0xE2, 0xFF }); // LDA $FFE2
+    add(SIGNATURE_E7, { 0xAD, 0xE5, 0xFF }); // LDA $FFE5
+    add(SIGNATURE_E7, { 0xAD, 0xE5, 0x1F }); // LDA $1FE5
+    add(SIGNATURE_E7, { 0xAD, 0xE7, 0x1F }); // LDA $1FE7
+    add(SIGNATURE_E7, { 0x0C, 0xE7, 0x1F }); // NOP $1FE7
+    add(SIGNATURE_E7, { 0x8D, 0xE7, 0xFF }); // STA $FFE7
+    add(SIGNATURE_E7, { 0x8D, 0xE7, 0x1F }); // STA $1FE7
+
+    add(SIGNATURE_FE, { 0x20, 0x00, 0xD0, 0xC6, 0xC5 }); // JSR $D000; DEC $C5
+    add(SIGNATURE_FE, { 0x20, 0xC3, 0xF8, 0xA5, 0x82 }); // JSR $F8C3; LDA $82
+    add(SIGNATURE_FE, { 0xD0, 0xFB, 0x20, 0x73, 0xFE }); // BNE $FB; JSR $FE73
+    add(SIGNATURE_FE, { 0x20, 0x00, 0xF0, 0x84, 0xD6 }); // JSR $F000; STY $D6
+
+    addHotspots(SIGNATURE_F8, { 0x1FF8, 0x1FF9 });
+    addHotspots(SIGNATURE_F6, { 0x1FF6, 0x1FF7 });
+    addHotspots(SIGNATURE_F4, { 0x1FF4, 0x1FF5, 0x1FFA, 0x1FFB });
+
+    return table;
+}();
+
+// The distinct values that byte index of a signature can have, so whole blocks can be filtered at once
+struct ByteSet
+{
+    byte Values[64];
+
+    size_t Count;
+
+    bool Contains[256];
+
+}; // struct ByteSet
+
+static constexpr ByteSet MakeByteSet(size_t index)
+{
+    ByteSet set = {};
+
+    for (size_t i = 0; i < SIGNATURES.Count; ++i) {
+        byte value = SIGNATURES.Entries[i].Bytes[index];
+        if (!set.Contains[value]) {
+            set.Contains[value] = true;
+            set.Values[set.Count++] = value;
+        }
+    }
+
+    return set;
+}
+
+static constexpr ByteSet FIRST_BYTES = MakeByteSet(0);
+
+static constexpr ByteSet SECOND_BYTES = MakeByteSet(1);
+
+///
+/// Scanning
+///
+
+// Counts every signature starting at offset, once its first two bytes have already matched
+static constexpr void MatchAt(const byte * data, size_t size, size_t offset, unsigned * counts)
+{
+    for (size_t i = 0; i < SIGNATURES.Count; ++i) {
+        const MapperSignature& signature = SIGNATURES.Entries[i];
+        if (offset + signature.Length > size) {
+            continue;
+        }
+
+        size_t length = 0;
+        while (length < signature.Length && data[offset + length] == signature.Bytes[length]) {
+            ++length;
+        }
+
+        if (length == signature.Length) {
+            ++counts[signature.Group];
+        }
+    }
+}
+
+// Adds up the signatures starting anywhere from start onwards into counts, indexed by SIGNATURE_*
+static constexpr void ScanScalar(const byte * data, size_t size, size_t start, unsigned * counts)
+{
+    for (size_t i = start; i + 1 < size; ++i) {
+        if (FIRST_BYTES.Contains[data[i]] && SECOND_BYTES.Contains[data[i + 1]]) {
+            MatchAt(data, size, i, counts);
+        }
+    }
+}
+
+#if !defined(FREYA2600_X86)
+
+static void ScanPortable(const byte * data, size_t size, unsigned * counts)
+{
+    ScanScalar(data, size, 0, counts);
+}
+
+#else
+
+// Blocks of 16 bytes, loading one byte past each for the second byte of a signature
+static void ScanSSE2(const byte * data, size_t size, unsigned * counts)
+{
+    size_t i = 0;
+
+    for (; i + 17 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i second = _mm_loadu_si128((const __m128i *)(data + i + 1));
+
+        __m128i firstMatch = _mm_setzero_si128();
+        for (size_t j = 0; j < FIRST_BYTES.Count; ++j) {
+            firstMatch = _mm_or_si128(firstMatch, _mm_cmpeq_epi8(first, _mm_set1_epi8(FIRST_BYTES.Values[j])));
+        }
+
+        if (_mm_movemask_epi8(firstMatch) == 0) {
+            continue;
+        }
+
+        __m128i secondMatch = _mm_setzero_si128();
+        for (size_t j = 0; j < SECOND_BYTES.Count; ++j) {
+            secondMatch = _mm_or_si128(secondMatch, _mm_cmpeq_epi8(second, _mm_set1_epi8(SECOND_BYTES.Values[j])));
+        }
+
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(firstMatch, secondMatch));
+        while (mask) {
+            MatchAt(data, size, i + std::countr_zero(mask), counts);
+            mask &= mask - 1;
+        }
+    }
+
+    ScanScalar(data, size, i, counts);
+}
+
+// The same as ScanSSE2, 32 bytes at a time
+FREYA2600_TARGET("avx2")
+static void ScanAVX2(const byte * data, size_t size, unsigned * counts)
+{
+    size_t i = 0;
+
+    for (; i + 33 <= size; i += 32) {
+        __m256i first = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i second = _mm256_loadu_si256((const __m256i *)(data + i + 1));
+
+        __m256i firstMatch = _mm256_setzero_si256();
+        for (size_t j = 0; j < FIRST_BYTES.Count; ++j) {
+            firstMatch = _mm256_or_si256(firstMatch, _mm256_cmpeq_epi8(first, _mm256_set1_epi8(FIRST_BYTES.Values[j])));
+        }
+
+        if (_mm256_movemask_epi8(firstMatch) == 0) {
+            continue;
+        }
+
+        __m256i secondMatch = _mm256_setzero_si256();
+        for (size_t j = 0; j < SECOND_BYTES.Count; ++j) {
+            secondMatch = _mm256_or_si256(secondMatch, _mm256_cmpeq_epi8(second, _mm256_set1_epi8(SECOND_BYTES.Values[j])));
+        }
+
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(firstMatch, secondMatch));
+        while (mask) {
+            MatchAt(data, size, i + std::countr_zero(mask), counts);
+            mask &= mask - 1;
+        }
+    }
+
+    ScanScalar(data, size, i, counts);
+}
+
+#endif // FREYA2600_X86
+
+typedef void (*ScanFunction)(const byte * data, size_t size, unsigned * counts);
+
+static ScanFunction SelectScan()
+{
+#if defined(FREYA2600_X86)
+    if (HasAVX2()) {
+        return &ScanAVX2;
+    }
+
+    return &ScanSSE2;
+#else
+    return &ScanPortable;
+#endif
+}
+
+static const ScanFunction Scan = SelectScan();
+
+///
+/// Ranking
+///
+
+struct MapperFeatures
+{
+    // Bytes of ROM
+    size_t Size;
+
+    // Whether the start of every bank could be Superchip RAM
+    bool Superchip;
+
+    // Number of times each group of signatures appears, indexed by SIGNATURE_*
+    unsigned Counts[SIGNATURE_GROUP_COUNT];
+
+}; // struct MapperFeatures
+
+// Superchip RAM reads back as whatever the ROM had under it, which is the same for the write port and the read port
+static bool HasSuperchip(const byte * data, size_t size, size_t ramSize)
+{
+    if (size < ROM_BANK_SIZE) {
+        return false;
+    }
+
+    for (size_t bank = 0; bank + ROM_BANK_SIZE <= size; bank += ROM_BANK_SIZE) {
+        if (memcmp(data + bank, data + bank + ramSize, ramSize) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Every mapper for a ROM of this size, ranked by what was found in it
+// Guesses with the same confidence stay in the order they were added
+static constexpr MapperDetection RankMappers(const MapperFeatures& features)
+{
+    MapperDetection detection;
+
+    auto add = [&](byte type, byte confidence) {
+        size_t index = detection.Count++;
+        while (index > 0 && detection.Guesses[index - 1].Confidence < confidence) {
+            detection.Guesses[index] = detection.Guesses[index - 1];
+            --index;
+        }
+
+        detection.Guesses[index] = { type, confidence };
+    };
+
+    const unsigned * counts = features.Counts;
+
+    // Switching back and forth takes at least two, a lone STA $3F is likely just a TIA write
+    auto add3F = [&]() {
+        if (counts[SIGNATURE_3F] >= 2) {
+            add(MAPPER_3F, 80);
+        }
+        else if (counts[SIGNATURE_3F] == 1) {
+            add(MAPPER_3F, 20);
+        }
+    };
+
+    // The plain Atari scheme is the fallback for its size, more so when its hotspots are used
+    auto addAtari = [&](byte type, unsigned hotspots) {
+        add(type, (hotspots > 0 ? 60 : 40));
+    };
+
+    size_t size = features.Size;
+
+    if (size <= ROM_BANK_SIZE) {
+        add(MAPPER_NONE, 100);
+    }
+    else if (size == 2 * ROM_BANK_SIZE) {
+        if (features.Superchip) {
+            add(MAPPER_F8SC, 95);
+        }
+
+        if (counts[SIGNATURE_E0] > 0) {
+            add(MAPPER_E0, 90);
+        }
+
+        add3F();
+
+        if (counts[SIGNATURE_FE] > 0) {
+            add(MAPPER_FE, 75);
+        }
+
+        addAtari(MAPPER_F8, counts[SIGNATURE_F8]);
+    }
+    else if (size == 3 * ROM_BANK_SIZE) {
+        add(MAPPER_FA, 90);
+    }
+    else if (size == 4 * ROM_BANK_SIZE) {
+        if (features.Superchip) {
+            add(MAPPER_F6SC, 95);
+        }
+
+        if (counts[SIGNATURE_E7] > 0) {
+            add(MAPPER_E7, 90);
+        }
+
+        add3F();
+
+        addAtari(MAPPER_F6, counts[SIGNATURE_F6]);
+    }
+    else if (size == 8 * ROM_BANK_SIZE) {
+        if (features.Superchip) {
+            add(MAPPER_F4SC, 95);
+        }
+
+        add3F();
+
+        addAtari(MAPPER_F4, counts[SIGNATURE_F4]);
+    }
+    else {
+        // Nothing else addresses this much ROM
+        add(MAPPER_3F, 50);
+    }
+
+    return detection;
+}
+
+MapperDetection DetectMappers(const byte * data, size_t size)
+{
+    MapperFeatures features = {};
+    features.Size = size;
+
+    // Nothing to tell apart without bank switching
+    if (size > ROM_BANK_SIZE) {
+        Scan(data, size, features.Counts);
+        features.Superchip = HasSuperchip(data, size, 0x80);
+
+#if !defined(NDEBUG)
+        unsigned counts[SIGNATURE_GROUP_COUNT] = {};
+        ScanScalar(data, size, 0, counts);
+        assert(memcmp(counts, features.Counts, sizeof(counts)) == 0);
+#endif
+    }
+
+    return RankMappers(features);
+}
+
+///
+/// Regression
+///
+
+// Ranks a synthetic image that only spells out the code that matters, standing in for a ROM of size bytes
+template <size_t N>
+static constexpr MapperDetection DetectSynthetic(const byte (&code)[N], size_t size, bool superchip = false)
+{
+    MapperFeatures features = {};
+    features.Size = size;
+    features.Superchip = superchip;
+
+    ScanScalar(code, N, 0, features.Counts);
+    return RankMappers(features);
+}
+
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F }, ROM_HALF_BANK_SIZE).Best() == MAPPER_NONE);
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F }, ROM_BANK_SIZE).Count == 1);
+
+// LDA $1FF8; STA $1FE0
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F, 0x8D, 0xE0, 0x1F }, 2 * ROM_BANK_SIZE).Best() == MAPPER_E0);
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F, 0x8D, 0xE0, 0x1F }, 2 * ROM_BANK_SIZE).Guesses[1].MapperType == MAPPER_F8);
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F }, 2 * ROM_BANK_SIZE).Guesses[0].Confidence == 60);
+static_assert(DetectSynthetic({ 0xEA, 0xEA, 0xEA }, 2 * ROM_BANK_SIZE).Guesses[0].Confidence == 40);
+static_assert(DetectSynthetic({ 0xAD, 0xF8, 0x1F }, 2 * ROM_BANK_SIZE, true).Best() == MAPPER_F8SC);
+
+// STA $3F twice, and a signature cut off by the end of the image
+static_assert(DetectSynthetic({ 0x85, 0x3F, 0xEA, 0x85, 0x3F, 0x20, 0x00, 0xD0 }, 2 * ROM_BANK_SIZE).Best() == MAPPER_3F);
+static_assert(DetectSynthetic({ 0x85, 0x3F, 0xEA }, 2 * ROM_BANK_SIZE).Best() == MAPPER_F8);
+
+// STA $1FE0 on the last bytes of the image, and missing its last byte
+static_assert(DetectSynthetic({ 0xEA, 0x8D, 0xE0, 0x1F }, 2 * ROM_BANK_SIZE).Best() == MAPPER_E0);
+static_assert(DetectSynthetic({ 0xEA, 0xEA, 0x8D, 0xE0 }, 2 * ROM_BANK_SIZE).Guesses[0].Confidence == 40);
+
+// JSR $D000; DEC $C5
+static_assert(DetectSynthetic({ 0x20, 0x00, 0xD0, 0xC6, 0xC5 }, 2 * ROM_BANK_SIZE).Best() == MAPPER_FE);
+
+static_assert(DetectSynthetic({ 0xEA }, 3 * ROM_BANK_SIZE).Best() == MAPPER_FA);
+
+// LDA $FFE5
+static_assert(DetectSynthetic({ 0xAD, 0xE5, 0xFF }, 4 * ROM_BANK_SIZE).Best() == MAPPER_E7);
+static_assert(DetectSynthetic({ 0x2C, 0xF6, 0xFF }, 4 * ROM_BANK_SIZE).Best() == MAPPER_F6);
+static_assert(DetectSynthetic({ 0xAD, 0xE5, 0xFF }, 4 * ROM_BANK_SIZE, true).Best() == MAPPER_F6SC);
+
+static_assert(DetectSynthetic({ 0x8D, 0xFB, 0x1F }, 8 * ROM_BANK_SIZE).Guesses[0].Confidence == 60);
+static_assert(DetectSynthetic({ 0x85, 0x3F, 0x85, 0x3F }, 8 * ROM_BANK_SIZE).Best() == MAPPER_3F);
+static_assert(DetectSynthetic({ 0xEA }, 64 * ROM_BANK_SIZE).Best() == MAPPER_3F);
@@ -0,0 +1,36 @@
+#ifndef MAPPER_DETECTION_HPP
+#define MAPPER_DETECTION_HPP
+
+#include <Config.hpp>
+#include <Types/Cartridge.hpp>
+
+#include <cstddef>
+
+// Out of 100, how sure detection is that a ROM uses a mapper
+struct MapperGuess
+{
+    // One of MAPPER_*
+    byte MapperType;
+
+    byte Confidence;
+
+}; // struct MapperGuess
+
+// Every mapper a ROM could plausibly use, most likely first
+struct MapperDetection
+{
+    MapperGuess Guesses[MAPPER_COUNT] = {};
+
+    size_t Count = 0;
+
+    constexpr byte Best() const {
+        return (Count > 0 ? Guesses[0].MapperType : MAPPER_NONE);
+    }
+
+}; // struct MapperDetection
+
+// Guesses the bank switching scheme of a ROM image from its size and the hotspots its code accesses
+// The byte pattern scans use AVX2 or SSE2 when the CPU has them
+MapperDetection DetectMappers(const byte * data, size_t size);
+
+#endif // MAPPER_DETECTION_HPP
@@ -0,0 +1,263 @@
+#include "PlayfieldExpansion.hpp"
+#include "Constants.hpp"
+#include "CPUFeatures.hpp"
+
+#include <algorithm>
+
+template <typename Pixel>
+using ExpandFunction = void (*)(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<Pixel>& colors, Pixel * line);
+
+// One pixel at a time, for the ends of spans and CPUs without vectors
+template <typename Pixel>
+static void ExpandScalar(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<Pixel>& colors, Pixel * line)
+{
+    for (unsigned x = first; x < last; ++x) {
+        if ((playfield >> (x / 4)) & 1) {
+            line[x] = (x > (SCREEN_WIDTH / 2) ? colors.Right : colors.Left);
+        }
+        else {
+            line[x] = colors.Background;
+        }
+    }
+}
+
+#if defined(FREYA2600_X86)
+
+///
+/// Blocks of 16 pixels, starting at a multiple of 16
+///
+
+// Where the vector loops start, the pixels before it are done one at a time
+static inline unsigned AlignFirst(unsigned first, unsigned last)
+{
+    return std::min((first + 15) & ~15u, last);
+}
+
+// 0xFF for each pixel from x that the playfield covers
+// A block spans 4 bits of the mask, each bit covering 4 pixels
+static inline __m128i CoveredMask(uint64_t playfield, unsigned x)
+{
+    const __m128i bits = _mm_setr_epi8(1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 8, 8, 8, 8);
+
+    __m128i nibble = _mm_set1_epi8((char)((playfield >> (x / 4)) & 0x0F));
+    return _mm_cmpeq_epi8(_mm_and_si128(nibble, bits), bits);
+}
+
+// 0xFF for each pixel from x past the middle of the screen
+static inline __m128i RightMask(unsigned x)
+{
+    const __m128i offsets = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    // There's no unsigned byte compare, so both sides are shifted down by 128
+    __m128i pixels = _mm_add_epi8(_mm_set1_epi8((char)(x - 128)), offsets);
+    return _mm_cmpgt_epi8(pixels, _mm_set1_epi8((char)((SCREEN_WIDTH / 2) - 128)));
+}
+
+static inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+struct VectorColors
+{
+    __m128i Background;
+    __m128i Left;
+    __m128i Right;
+
+}; // struct VectorColors
+
+static inline void ExpandIndexed16(uint64_t playfield, unsigned x, const VectorColors& colors, byte * line)
+{
+    __m128i color = Select(RightMask(x), colors.Right, colors.Left);
+    color = Select(CoveredMask(playfield, x), color, colors.Background);
+
+    _mm_storeu_si128((__m128i *)(line + x), color);
+}
+
+static inline void ExpandHost16(uint64_t playfield, unsigned x, const VectorColors& colors, uint32_t * line)
+{
+    __m128i covered = CoveredMask(playfield, x);
+    __m128i right = RightMask(x);
+
+    // Each byte of the masks widened out to a pixel, 4 pixels per vector
+    __m128i coveredLow = _mm_unpacklo_epi8(covered, covered);
+    __m128i coveredHigh = _mm_unpackhi_epi8(covered, covered);
+    __m128i rightLow = _mm_unpacklo_epi8(right, right);
+    __m128i rightHigh = _mm_unpackhi_epi8(right, right);
+
+    __m128i coveredPixels[4] = {
+        _mm_unpacklo_epi16(coveredLow, coveredLow),
+        _mm_unpackhi_epi16(coveredLow, coveredLow),
+        _mm_unpacklo_epi16(coveredHigh, coveredHigh),
+        _mm_unpackhi_epi16(coveredHigh, coveredHigh),
+    };
+
+    __m128i rightPixels[4] = {
+        _mm_unpacklo_epi16(rightLow, rightLow),
+        _mm_unpackhi_epi16(rightLow, rightLow),
+        _mm_unpacklo_epi16(rightHigh, rightHigh),
+        _mm_unpackhi_epi16(rightHigh, rightHigh),
+    };
+
+    for (unsigned i = 0; i < 4; ++i) {
+        __m128i color = Select(rightPixels[i], colors.Right, colors.Left);
+        color = Select(coveredPixels[i], color, colors.Background);
+
+        _mm_storeu_si128((__m128i *)(line + x + (i * 4)), color);
+    }
+}
+
+///
+/// SSE
+///
+
+static void ExpandIndexedSSE2(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<byte>& colors, byte * line)
+{
+    unsigned x = AlignFirst(first, last);
+    ExpandScalar(playfield, first, x, colors, line);
+
+    VectorColors vectors = {
+        .Background = _mm_set1_epi8((char)colors.Background),
+        .Left = _mm_set1_epi8((char)colors.Left),
+        .Right = _mm_set1_epi8((char)colors.Right),
+    };
+
+    for (; x + 16 <= last; x += 16) {
+        ExpandIndexed16(playfield, x, vectors, line);
+    }
+
+    ExpandScalar(playfield, x, last, colors, line);
+}
+
+static void ExpandHostSSE2(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<uint32_t>& colors, uint32_t * line)
+{
+    unsigned x = AlignFirst(first, last);
+    ExpandScalar(playfield, first, x, colors, line);
+
+    VectorColors vectors = {
+        .Background = _mm_set1_epi32((int)colors.Background),
+        .Left = _mm_set1_epi32((int)colors.Left),
+        .Right = _mm_set1_epi32((int)colors.Right),
+    };
+
+    for (; x + 16 <= last; x += 16) {
+        ExpandHost16(playfield, x, vectors, line);
+    }
+
+    ExpandScalar(playfield, x, last, colors, line);
+}
+
+///
+/// AVX2, 32 pixels at a time where the span allows, then 16
+///
+
+FREYA2600_TARGET("avx2")
+static void ExpandIndexedAVX2(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<byte>& colors, byte * line)
+{
+    unsigned x = AlignFirst(first, last);
+    ExpandScalar(playfield, first, x, colors, line);
+
+    __m256i background = _mm256_set1_epi8((char)colors.Background);
+    __m256i left = _mm256_set1_epi8((char)colors.Left);
+    __m256i right = _mm256_set1_epi8((char)colors.Right);
+
+    for (; x + 32 <= last; x += 32) {
+        __m256i covered = _mm256_set_m128i(CoveredMask(playfield, x + 16), CoveredMask(playfield, x));
+        __m256i rightSide = _mm256_set_m128i(RightMask(x + 16), RightMask(x));
+
+        __m256i color = _mm256_blendv_epi8(left, right, rightSide);
+        color = _mm256_blendv_epi8(background, color, covered);
+
+        _mm256_storeu_si256((__m256i *)(line + x), color);
+    }
+
+    VectorColors vectors = {
+        .Background = _mm256_castsi256_si128(background),
+        .Left = _mm256_castsi256_si128(left),
+        .Right = _mm256_castsi256_si128(right),
+    };
+
+    for (; x + 16 <= last; x += 16) {
+        ExpandIndexed16(playfield, x, vectors, line);
+    }
+
+    ExpandScalar(playfield, x, last, colors, line);
+}
+
+FREYA2600_TARGET("avx2")
+static void ExpandHostAVX2(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<uint32_t>& colors, uint32_t * line)
+{
+    unsigned x = AlignFirst(first, last);
+    ExpandScalar(playfield, first, x, colors, line);
+
+    __m256i background = _mm256_set1_epi32((int)colors.Background);
+    __m256i left = _mm256_set1_epi32((int)colors.Left);
+    __m256i right = _mm256_set1_epi32((int)colors.Right);
+
+    for (; x + 16 <= last; x += 16) {
+        __m128i covered = CoveredMask(playfield, x);
+        __m128i rightSide = RightMask(x);
+
+        // Sign extending the masks widens them out to a pixel each, 8 pixels per vector
+        for (unsigned i = 0; i < 2; ++i) {
+            __m256i coveredPixels = _mm256_cvtepi8_epi32(covered);
+            __m256i rightPixels = _mm256_cvtepi8_epi32(rightSide);
+
+            __m256i color = _mm256_blendv_epi8(left, right, rightPixels);
+            color = _mm256_blendv_epi8(background, color, coveredPixels);
+
+            _mm256_storeu_si256((__m256i *)(line + x + (i * 8)), color);
+
+            covered = _mm_srli_si128(covered, 8);
+            rightSide = _mm_srli_si128(rightSide, 8);
+        }
+    }
+
+    ExpandScalar(playfield, x, last, colors, line);
+}
+
+#endif // FREYA2600_X86
+
+///
+/// Dispatch
+///
+
+static ExpandFunction<byte> SelectIndexed()
+{
+#if defined(FREYA2600_X86)
+    if (HasAVX2()) {
+        return &ExpandIndexedAVX2;
+    }
+
+    return &ExpandIndexedSSE2;
+#else
+    return &ExpandScalar<byte>;
+#endif
+}
+
+static ExpandFunction<uint32_t> SelectHost()
+{
+#if defined(FREYA2600_X86)
+    if (HasAVX2()) {
+        return &ExpandHostAVX2;
+    }
+
+    return &ExpandHostSSE2;
+#else
+    return &ExpandScalar<uint32_t>;
+#endif
+}
+
+static const ExpandFunction<byte> ExpandIndexed = SelectIndexed();
+static const ExpandFunction<uint32_t> ExpandHost = SelectHost();
+
+void ExpandPlayfield(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<byte>& colors, byte * line)
+{
+    ExpandIndexed(playfield, first, last, colors, line);
+}
+
+void ExpandPlayfield(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<uint32_t>& colors, uint32_t * line)
+{
+    ExpandHost(playfield, first, last, colors, line);
+}
+
@@ -0,0 +1,28 @@
+#ifndef PLAYFIELD_EXPANSION_HPP
+#define PLAYFIELD_EXPANSION_HPP
+
+#include <Config.hpp>
+
+// What the playfield is drawn with, in the format of the pixels being written
+template <typename Pixel>
+struct PlayfieldColors
+{
+    Pixel Background;
+
+    // The playfield on either half of the screen, which are only different in score mode
+    Pixel Left;
+    Pixel Right;
+
+}; // struct PlayfieldColors
+
+// Fills pixels first to last - 1 of a line with the playfield and background, from a mask like TIARenderState::Playfield
+// line points at pixel 0, and pixels past the middle of the screen take the right color
+// Uses AVX2 or SSE when the CPU has them
+
+// Palette indices, one byte per pixel
+void ExpandPlayfield(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<byte>& colors, byte * line);
+
+// 32-bit colors, in whatever format the screen takes
+void ExpandPlayfield(uint64_t playfield, unsigned first, unsigned last, const PlayfieldColors<uint32_t>& colors, uint32_t * line);
+
+#endif // PLAYFIELD_EXPANSION_HPP
@@ -0,0 +1,111 @@
+#include "ROMCache.hpp"
+
+#include <cstring>
+
+constexpr uint32_t ROM_CACHE_MAGIC = 0x36324652; // "RF26"
+
+// Bump whenever DetectMapper changes, so guesses from the old one aren't reused
+constexpr uint32_t ROM_CACHE_VERSION = 1;
+
+struct ROMCacheHeader
+{
+    uint32_t Magic;
+
+    uint32_t Version;
+
+    // The records are ROMMetadata as this build lays it out
+    uint32_t RecordSize;
+
+}; // struct ROMCacheHeader
+
+static constexpr ROMCacheHeader ROM_CACHE_HEADER = {
+    .Magic = ROM_CACHE_MAGIC,
+    .Version = ROM_CACHE_VERSION,
+    .RecordSize = sizeof(ROMMetadata),
+};
+
+ROMCache::~ROMCache()
+{
+    if (File) {
+        fclose(File);
+        File = nullptr;
+    }
+}
+
+void ROMCache::Open(const char * filename)
+{
+    if (File && Filename == filename) {
+        return;
+    }
+
+    if (File) {
+        fclose(File);
+        File = nullptr;
+    }
+
+    Filename = filename;
+    Entries.clear();
+
+    bool valid = false;
+
+    FILE * file = fopen(filename, "rb");
+    if (file) {
+        ROMCacheHeader header;
+        if (fread(&header, sizeof(header), 1, file) == 1) {
+            valid = (memcmp(&header, &ROM_CACHE_HEADER, sizeof(header)) == 0);
+        }
+
+        // Later records replace earlier ones for the same ROM
+        ROMMetadata metadata;
+        while (valid && fread(&metadata, sizeof(metadata), 1, file) == 1) {
+            Entries[metadata.Hash] = metadata;
+        }
+
+        fclose(file);
+    }
+
+    if (!valid) {
+        file = fopen(filename, "wb");
+        if (!file) {
+            printf("Failed to create ROM cache: %s\n", filename);
+            return;
+        }
+
+        fwrite(&ROM_CACHE_HEADER, sizeof(ROM_CACHE_HEADER), 1, file);
+        fclose(file);
+    }
+
+    File = fopen(filename, "ab");
+}
+
+const ROMMetadata * ROMCache::Find(uint64_t hash, uint32_t size) const
+{
+    auto it = Entries.find(hash);
+    if (it == Entries.end() || it->second.Size != size) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+void ROMCache::Store(const ROMMetadata& metadata)
+{
+    Entries[metadata.Hash] = metadata;
+
+    if (!File) {
+        return;
+    }
+
+    // Keep padding out of the file, so the same metadata always writes the same bytes
+    ROMMetadata record;
+    memset(&record, 0, sizeof(record));
+    record.Hash = metadata.Hash;
+    record.Size = metadata.Size;
+    record.MapperType = metadata.MapperType;
+    record.Entrypoint = metadata.Entrypoint;
+    record.RootCount = metadata.RootCount;
+    memcpy(record.Roots, metadata.Roots, sizeof(record.Roots));
+
+    fwrite(&record, sizeof(record), 1, File);
+    fflush(File);
+}
@@ -0,0 +1,58 @@
+#ifndef ROM_CACHE_HPP
+#define ROM_CACHE_HPP
+
+#include <Config.hpp>
+
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+constexpr size_t ROM_METADATA_MAX_ROOTS = 16;
+
+// What was worked out about a ROM the first time it was loaded
+struct ROMMetadata
+{
+    uint64_t Hash;
+
+    uint32_t Size;
+
+    // One of MAPPER_*
+    byte MapperType;
+
+    word Entrypoint;
+
+    // Addresses the debugger had to disassemble from, past the ones the vectors lead to
+    byte RootCount;
+
+    word Roots[ROM_METADATA_MAX_ROOTS];
+
+}; // struct ROMMetadata
+
+// ROMMetadata for every ROM that has been loaded, kept on disk and keyed by the hash of the image
+// Records are only ever appended, so any number of emulators can share one cache file
+class ROMCache
+{
+public:
+
+    ~ROMCache();
+
+    // Reads every record in filename, starting over if it's missing or from another version
+    void Open(const char * filename);
+
+    // Returns nullptr if this ROM hasn't been seen before
+    const ROMMetadata * Find(uint64_t hash, uint32_t size) const;
+
+    // Adds or replaces the metadata for a ROM, in memory and on disk
+    void Store(const ROMMetadata& metadata);
+
+private:
+
+    std::string Filename;
+
+    FILE * File = nullptr;
+
+    std::unordered_map<uint64_t, ROMMetadata> Entries;
+
+}; // class ROMCache
+
+#endif // ROM_CACHE_HPP
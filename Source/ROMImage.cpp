@@ -0,0 +1,223 @@
+#include "ROMImage.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+uint64_t HashROMData(const byte * data, size_t size)
+{
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 0x100000001B3;
+    }
+
+    return hash;
+}
+
+// Identifies the file itself rather than the path to it, and changes if the file is rewritten
+static std::string GetFileKey(const char * filename)
+{
+#if !defined(_WIN32)
+    struct stat info;
+    if (stat(filename, &info) < 0) {
+        return {};
+    }
+
+    char key[128];
+    snprintf(key, sizeof(key), "%llx:%llx:%llx:%llx",
+        (unsigned long long)info.st_dev,
+        (unsigned long long)info.st_ino,
+        (unsigned long long)info.st_size,
+        (unsigned long long)info.st_mtime);
+    return key;
+#else
+    return filename;
+#endif
+}
+
+std::shared_ptr<const ROMImage> ROMImage::Load(const char * filename)
+{
+    static std::mutex registryMutex;
+    static std::unordered_map<std::string, std::weak_ptr<const ROMImage>> registry;
+
+    std::string key = GetFileKey(filename);
+
+    if (!key.empty()) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+
+        auto it = registry.find(key);
+        if (it != registry.end()) {
+            if (auto image = it->second.lock()) {
+                return image;
+            }
+        }
+    }
+
+    // Loaded without the lock, so different files can be loaded in parallel
+    std::shared_ptr<const ROMImage> image = LoadFile(filename);
+    if (!image || key.empty()) {
+        return image;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+
+    // Another emulator loaded the same file in the meantime, share theirs
+    auto it = registry.find(key);
+    if (it != registry.end()) {
+        if (auto existing = it->second.lock()) {
+            return existing;
+        }
+    }
+
+    // Forget images nobody is running anymore
+    for (auto it = registry.begin(); it != registry.end(); ) {
+        if (it->second.expired()) {
+            it = registry.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+
+    registry[key] = image;
+    return image;
+}
+
+std::shared_ptr<const ROMImage> ROMImage::LoadFile(const char * filename)
+{
+    std::shared_ptr<ROMImage> image(new ROMImage());
+
+    std::vector<byte> buffer;
+
+#if !defined(_WIN32)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t fileSize = info.st_size;
+
+    // Anything that is already whole banks is used straight from the page cache
+    if (fileSize > 0 && (fileSize % ROM_BANK_SIZE) == 0) {
+        void * mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            close(fd);
+
+            image->Mapping = mapping;
+            image->MappingSize = fileSize;
+            image->Data = (const byte *)mapping;
+            image->Size = fileSize;
+            image->BankCount = fileSize / ROM_BANK_SIZE;
+            image->Hash = HashROMData(image->Data, image->Size);
+            return image;
+        }
+    }
+
+    buffer.resize(fileSize);
+    if (fileSize > 0 && read(fd, buffer.data(), fileSize) != (ssize_t)fileSize) {
+        close(fd);
+        return nullptr;
+    }
+
+    close(fd);
+#else
+    FILE * file = fopen(filename, "rb");
+    if (!file) {
+        return nullptr;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    buffer.resize(fileSize);
+    if (fread(buffer.data(), 1, fileSize, file) != fileSize) {
+        fclose(file);
+        return nullptr;
+    }
+
+    fclose(file);
+#endif
+
+    // Deal with undersized ROMs
+    if (buffer.size() == ROM_HALF_BANK_SIZE) {
+        buffer.insert(buffer.end(), buffer.begin(), buffer.end());
+    }
+
+    image->Size = buffer.size();
+
+    // Pad out to a whole bank, so every bank can be mapped in
+    image->BankCount = std::max<size_t>((image->Size + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE, 1);
+    buffer.resize(image->BankCount * ROM_BANK_SIZE, 0x00);
+
+    if (!image->Seal(buffer)) {
+        return nullptr;
+    }
+
+    image->Hash = HashROMData(image->Data, image->Size);
+    return image;
+}
+
+bool ROMImage::Seal(const std::vector<byte>& data)
+{
+    // Whole pages, like a mapping would be
+    size_t size = (data.size() + ROM_IMAGE_ALIGNMENT - 1) & ~(ROM_IMAGE_ALIGNMENT - 1);
+
+#if !defined(_WIN32)
+    void * memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+
+    memcpy(memory, data.data(), data.size());
+    mprotect(memory, size, PROT_READ);
+#else
+    void * memory = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!memory) {
+        return false;
+    }
+
+    memcpy(memory, data.data(), data.size());
+
+    DWORD oldProtect;
+    VirtualProtect(memory, size, PAGE_READONLY, &oldProtect);
+#endif
+
+    Mapping = memory;
+    MappingSize = size;
+    Data = (const byte *)memory;
+    return true;
+}
+
+ROMImage::~ROMImage()
+{
+    if (Mapping) {
+#if !defined(_WIN32)
+        munmap(Mapping, MappingSize);
+#else
+        VirtualFree(Mapping, 0, MEM_RELEASE);
+#endif
+        Mapping = nullptr;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef ROM_IMAGE_HPP
+#define ROM_IMAGE_HPP
+
+#include <Config.hpp>
+#include <Constants.hpp>
+
+#include <memory>
+#include <vector>
+
+// What ROM points at before a cartridge is loaded
+inline constexpr byte BLANK_ROM[1][ROM_BANK_SIZE] = {};
+
+// Images that have to be copied are kept in memory aligned to this, so they start on a page like mapped ones do
+constexpr size_t ROM_IMAGE_ALIGNMENT = 4096;
+
+// A cartridge image, mapped straight from the file when it can be used as is
+// Images are read only once loaded, so every emulator running the same file shares one
+class ROMImage
+{
+public:
+
+    // Returns the image already loaded from this file if there is one, or nullptr if the file can't be read
+    static std::shared_ptr<const ROMImage> Load(const char * filename);
+
+    ROMImage(const ROMImage&) = delete;
+
+    ROMImage& operator=(const ROMImage&) = delete;
+
+    ~ROMImage();
+
+    // Whole banks, Size rounded up to ROM_BANK_SIZE
+    const byte * Data = nullptr;
+
+    // Bytes of ROM, with 2K images already mirrored to 4K
+    size_t Size = 0;
+
+    size_t BankCount = 0;
+
+    // FNV-1a of the Size bytes of ROM
+    uint64_t Hash = 0;
+
+private:
+
+    ROMImage() = default;
+
+    static std::shared_ptr<const ROMImage> LoadFile(const char * filename);
+
+    // Moves data into page aligned memory, which is made read only where the platform allows it
+    bool Seal(const std::vector<byte>& data);
+
+    // The file mapping, or the sealed copy, that Data points into
+    void * Mapping = nullptr;
+
+    size_t MappingSize = 0;
+
+}; // class ROMImage
+
+uint64_t HashROMData(const byte * data, size_t size);
+
+#endif // ROM_IMAGE_HPP
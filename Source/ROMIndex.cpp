@@ -0,0 +1,206 @@
+#include "ROMIndex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if !defined(_WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+constexpr uint32_t ROM_INDEX_MAGIC = 0x49324652; // "RF2I"
+
+// Bump whenever ROMIndexEntry changes
+constexpr uint32_t ROM_INDEX_VERSION = 1;
+
+struct ROMIndexHeader
+{
+    uint32_t Magic;
+
+    uint32_t Version;
+
+    uint32_t RecordSize;
+
+    uint32_t Count;
+
+    // Bytes of paths after the records
+    uint64_t StringsSize;
+
+}; // struct ROMIndexHeader
+
+static_assert(sizeof(ROMIndexEntry) == 24, "ROMIndexEntry is written to disk as is");
+static_assert(sizeof(ROMIndexHeader) % alignof(ROMIndexEntry) == 0, "Records have to be aligned in the mapping");
+
+ROMIndex::~ROMIndex()
+{
+    Close();
+}
+
+void ROMIndex::Close()
+{
+#if !defined(_WIN32)
+    if (Mapping) {
+        munmap(Mapping, MappingSize);
+        Mapping = nullptr;
+    }
+#endif
+
+    Buffer.clear();
+
+    Entries = nullptr;
+    Count = 0;
+    Strings = nullptr;
+    StringsSize = 0;
+}
+
+bool ROMIndex::Open(const char * filename)
+{
+    Close();
+
+    const byte * data = nullptr;
+    size_t size = 0;
+
+#if !defined(_WIN32)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || info.st_size < (off_t)sizeof(ROMIndexHeader)) {
+        close(fd);
+        return false;
+    }
+
+    void * mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    Mapping = mapping;
+    MappingSize = info.st_size;
+
+    data = (const byte *)Mapping;
+    size = MappingSize;
+#else
+    FILE * file = fopen(filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    Buffer.resize(fileSize);
+    if (fread(Buffer.data(), 1, fileSize, file) != fileSize) {
+        fclose(file);
+        Close();
+        return false;
+    }
+
+    fclose(file);
+
+    data = Buffer.data();
+    size = Buffer.size();
+#endif
+
+    ROMIndexHeader header;
+    if (size < sizeof(header)) {
+        Close();
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    size_t recordsSize = (size_t)header.Count * sizeof(ROMIndexEntry);
+
+    bool valid = (header.Magic == ROM_INDEX_MAGIC)
+        && (header.Version == ROM_INDEX_VERSION)
+        && (header.RecordSize == sizeof(ROMIndexEntry))
+        && (sizeof(header) + recordsSize + header.StringsSize <= size);
+
+    if (!valid) {
+        Close();
+        return false;
+    }
+
+    Entries = (const ROMIndexEntry *)(data + sizeof(header));
+    Count = header.Count;
+    Strings = (const char *)(data + sizeof(header) + recordsSize);
+    StringsSize = header.StringsSize;
+    return true;
+}
+
+bool ROMIndex::Write(const char * filename, std::vector<std::pair<ROMIndexEntry, std::string>> entries)
+{
+    // Same hash in path order, so the index comes out the same however the files were scanned
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) {
+        if (a.first.Hash != b.first.Hash) {
+            return a.first.Hash < b.first.Hash;
+        }
+
+        return a.second < b.second;
+    });
+
+    std::string strings;
+    for (auto& [entry, path] : entries) {
+        entry.PathOffset = (uint32_t)strings.size();
+        memset(entry.Reserved, 0, sizeof(entry.Reserved));
+
+        strings += path;
+        strings += '\0';
+    }
+
+    ROMIndexHeader header = {
+        .Magic = ROM_INDEX_MAGIC,
+        .Version = ROM_INDEX_VERSION,
+        .RecordSize = sizeof(ROMIndexEntry),
+        .Count = (uint32_t)entries.size(),
+        .StringsSize = strings.size(),
+    };
+
+    FILE * file = fopen(filename, "wb");
+    if (!file) {
+        return false;
+    }
+
+    bool written = (fwrite(&header, sizeof(header), 1, file) == 1);
+
+    for (const auto& [entry, path] : entries) {
+        written = written && (fwrite(&entry, sizeof(entry), 1, file) == 1);
+    }
+
+    written = written && (fwrite(strings.data(), 1, strings.size(), file) == strings.size());
+
+    return (fclose(file) == 0) && written;
+}
+
+const ROMIndexEntry * ROMIndex::Find(uint64_t hash) const
+{
+    const ROMIndexEntry * end = Entries + Count;
+
+    const ROMIndexEntry * entry = std::lower_bound(Entries, end, hash, [](const ROMIndexEntry& entry, uint64_t hash) {
+        return entry.Hash < hash;
+    });
+
+    if (entry == end || entry->Hash != hash) {
+        return nullptr;
+    }
+
+    return entry;
+}
+
+const char * ROMIndex::GetPath(const ROMIndexEntry& entry) const
+{
+    if (entry.PathOffset >= StringsSize) {
+        return "";
+    }
+
+    return Strings + entry.PathOffset;
+}
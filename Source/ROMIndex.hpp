@@ -0,0 +1,72 @@
+#ifndef ROM_INDEX_HPP
+#define ROM_INDEX_HPP
+
+#include <Config.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// What freya2600-index found out about one ROM file
+struct ROMIndexEntry
+{
+    uint64_t Hash;
+
+    uint32_t Size;
+
+    // Offset of the path to the file in the string table, which is NUL terminated
+    uint32_t PathOffset;
+
+    // Where the CPU starts, read from $FFFC with the power on banks mapped
+    word Entrypoint;
+
+    // One of MAPPER_*
+    byte MapperType;
+
+    // Pads records out to 8 bytes, always 0
+    byte Reserved[5];
+
+}; // struct ROMIndexEntry
+
+// An index of a ROM collection written by freya2600-index, mapped straight from the file
+// Entries are sorted by hash, followed by the string table of paths
+class ROMIndex
+{
+public:
+
+    ~ROMIndex();
+
+    // Returns false if the file is missing or from another version
+    bool Open(const char * filename);
+
+    // Sorts the entries by hash and writes them out with their paths, returns false if the file can't be written
+    static bool Write(const char * filename, std::vector<std::pair<ROMIndexEntry, std::string>> entries);
+
+    // The first entry for a ROM, others with the same hash follow it, or nullptr if it isn't in the index
+    const ROMIndexEntry * Find(uint64_t hash) const;
+
+    const char * GetPath(const ROMIndexEntry& entry) const;
+
+    const ROMIndexEntry * Entries = nullptr;
+
+    size_t Count = 0;
+
+private:
+
+    void Close();
+
+    // The file mapping, or a copy of the file where it can't be mapped
+    void * Mapping = nullptr;
+
+    size_t MappingSize = 0;
+
+    std::vector<byte> Buffer;
+
+    const char * Strings = nullptr;
+
+    size_t StringsSize = 0;
+
+}; // class ROMIndex
+
+#endif // ROM_INDEX_HPP
@@ -0,0 +1,17 @@
+#ifndef RECOMPILED_HPP
+#define RECOMPILED_HPP
+
+#include <Config.hpp>
+#include <Types/CPU.hpp>
+
+#include <cstddef>
+
+// Defined by the translation unit that freya2600-recompile generates for a cartridge
+
+extern const uint64_t RECOMPILED_ROM_HASH;
+
+extern const RecompiledBlockEntry RECOMPILED_BLOCKS[];
+
+extern const size_t RECOMPILED_BLOCK_COUNT;
+
+#endif // RECOMPILED_HPP
@@ -2,6 +2,11 @@
 #define TYPES_CPU_HPP
 
 #include <Config.hpp>
+#include <Utility.hpp>
+
+#include <vector>
+
+class Emulator;
 
 union OperationCode {
     struct {
@@ -19,4 +24,153 @@ union OperationCode {
     uint8_t _raw;
 };
 
+// The OperationCode bitfields, split out so they can be used in constant expressions
+constexpr unsigned OpcodeGroup(byte opcode) { return (opcode & 0b11); }
+constexpr unsigned OpcodeMode(byte opcode) { return ((opcode >> 2) & 0b111); }
+constexpr unsigned OpcodeInst(byte opcode) { return (opcode >> 5); }
+constexpr unsigned OpcodeTest(byte opcode) { return ((opcode >> 5) & 0b1); }
+constexpr unsigned OpcodeFlag(byte opcode) { return (opcode >> 6); }
+
+// Instructions with no operand decoding, handled individually
+constexpr bool IsImplied(byte opcode)
+{
+    switch (opcode) {
+    case 0x00: case 0x20: case 0x40: case 0x60:
+    case 0x08: case 0x28: case 0x48: case 0x68:
+    case 0x88: case 0xA8: case 0xC8: case 0xE8:
+    case 0x18: case 0x38: case 0x58: case 0x78:
+    case 0x98: case 0xB8: case 0xD8: case 0xF8:
+    case 0x8A: case 0x9A: case 0xAA: case 0xBA:
+    case 0xCA: case 0xEA:
+        return true;
+    }
+
+    return false;
+}
+
+// Number of operand bytes following the opcode
+constexpr unsigned OperandLength(byte opcode)
+{
+    unsigned group = OpcodeGroup(opcode);
+    unsigned mode = OpcodeMode(opcode);
+
+    if (IsImplied(opcode)) {
+        return (opcode == 0x20 ? 2 : 0); // JSR
+    }
+
+    // Branch Instructions
+    if (group == 0b00 && mode == 0b100) {
+        return 1;
+    }
+
+    // Group 11 has no official instructions
+    if (group == 0b11) {
+        return 0;
+    }
+
+    switch (mode) {
+    // Absolute, Absolute,X/Y
+    case 0b011:
+    case 0b111:
+        return 2;
+
+    // Absolute,Y in group 01, nothing in group 10
+    case 0b110:
+        return (group == 0b01 ? 2 : 0);
+
+    // #Immediate and (Zero Page),Y in group 01, Accumulator and nothing in group 10
+    case 0b010:
+    case 0b100:
+        return (group == 0b01 ? 1 : 0);
+
+    // #Immediate, Zero Page, Zero Page,X/Y and (Zero Page,X)
+    default:
+        return 1;
+    }
+}
+
+// Branches, jumps, calls and returns
+constexpr bool EndsBlock(byte opcode)
+{
+    if (IsIn(opcode, { 0x00, 0x20, 0x40, 0x60 })) { // BRK, JSR, RTI, RTS
+        return true;
+    }
+
+    // Branch Instructions
+    if (OpcodeGroup(opcode) == 0b00 && OpcodeMode(opcode) == 0b100) {
+        return true;
+    }
+
+    // JMP and JMP Indirect, in every addressing mode
+    return (!IsImplied(opcode) && OpcodeGroup(opcode) == 0b00 && (OpcodeInst(opcode) == 0b010 || OpcodeInst(opcode) == 0b011));
+}
+
+// A store to one TIA register, see Emulator::WriteTIA
+typedef void (Emulator::*TIAWriteHandler)(byte data);
+
+// Instructions in a block that run together as one superinstruction, see Emulator::StepFused
+constexpr byte FUSION_NONE                  = 0;
+constexpr byte FUSION_LDA_IMMEDIATE_STA_TIA = 1; // LDA #Immediate, STA to a TIA register
+constexpr byte FUSION_LDA_INDIRECT_STA_TIA  = 2; // LDA (Zero Page),Y, STA to a TIA register
+constexpr byte FUSION_STA_WSYNC             = 3; // STA WSYNC, and the wait for the end of the line
+
+constexpr size_t FUSION_COUNT = 4;
+
+constexpr const char * FUSION_NAMES[FUSION_COUNT] = {
+    "None",
+    "LDA #imm / STA TIA",
+    "LDA (zp),Y / STA TIA",
+    "STA WSYNC",
+};
+
+// An instruction decoded ahead of time from ROM
+struct DecodedInstruction
+{
+    // Emulator::Operate specialized for Opcode
+    void (Emulator::*Handler)(word operand);
+
+    word Operand;
+
+    byte Opcode;
+
+    // Size of the opcode and operand, which is also the base cycle cost of fetching them
+    byte Length;
+
+    // One of FUSION_*, set on the first instruction of a superinstruction
+    byte Fusion = FUSION_NONE;
+
+    // For a store in a superinstruction, the TIA register it writes
+    TIAWriteHandler TIAWrite = nullptr;
+
+}; // struct DecodedInstruction
+
+// A straight run of instructions, ending at the first branch, jump, call or return
+struct DecodedBlock
+{
+    std::vector<DecodedInstruction> Instructions;
+
+#if defined(FREYA2600_JIT)
+    // Number of times the block has run, until it gets translated
+    unsigned ExecutionCount = 0;
+
+    // The translated block, or nullptr if it hasn't been translated
+    void (*Native)(Emulator * emu) = nullptr;
+#endif
+
+}; // struct DecodedBlock
+
+// A basic block compiled ahead of time by freya2600-recompile
+typedef void (*RecompiledBlock)(Emulator * emu);
+
+struct RecompiledBlockEntry
+{
+    unsigned Bank;
+
+    // Offset of the first instruction into the bank
+    word Offset;
+
+    RecompiledBlock Function;
+
+}; // struct RecompiledBlockEntry
+
 #endif // TYPES_CPU_HPP
\ No newline at end of file
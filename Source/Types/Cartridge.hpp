@@ -0,0 +1,51 @@
+#ifndef TYPES_CARTRIDGE_HPP
+#define TYPES_CARTRIDGE_HPP
+
+#include <Config.hpp>
+
+#include <cstddef>
+
+class Emulator;
+
+// Bank switching schemes, see Emulator-Cartridge.cpp
+constexpr byte MAPPER_NONE = 0;  // 2K or 4K, no bank switching
+constexpr byte MAPPER_F8   = 1;  // 8K Atari
+constexpr byte MAPPER_F8SC = 2;  // 8K Atari with Superchip RAM
+constexpr byte MAPPER_F6   = 3;  // 16K Atari
+constexpr byte MAPPER_F6SC = 4;  // 16K Atari with Superchip RAM
+constexpr byte MAPPER_F4   = 5;  // 32K Atari
+constexpr byte MAPPER_F4SC = 6;  // 32K Atari with Superchip RAM
+constexpr byte MAPPER_E0   = 7;  // 8K Parker Brothers
+constexpr byte MAPPER_E7   = 8;  // 16K M-Network
+constexpr byte MAPPER_3F   = 9;  // Up to 512K Tigervision
+constexpr byte MAPPER_FE   = 10; // 8K Activision
+constexpr byte MAPPER_FA   = 11; // 12K CBS RAM Plus
+
+constexpr size_t MAPPER_COUNT = 12;
+
+// A mapper policy, flattened into plain functions when the cartridge is loaded
+struct MapperInfo
+{
+    const char * Name;
+
+    // Size of the pieces of ROM that get switched, code isn't cached across them
+    size_t SliceSize;
+
+    // Offset into each 4K of ROM where the hotspots start, code past it isn't cached
+    size_t HotspotStart;
+
+    // Whether Write has to see writes to the TIA, for mappers that switch banks there
+    bool WatchesTIA;
+
+    // Selects the power on banks and maps every page of the cartridge
+    void (*Reset)(Emulator * emu);
+
+    // Accesses to the pages that are left to the mapper, address has not been masked
+    // Reads that don't tick must not change anything, Emulator::Peek relies on it
+    byte (*Read)(Emulator * emu, word address, bool tick);
+
+    void (*Write)(Emulator * emu, word address, byte data);
+
+}; // struct MapperInfo
+
+#endif // TYPES_CARTRIDGE_HPP
@@ -0,0 +1,42 @@
+#ifndef TYPES_MEMORY_HPP
+#define TYPES_MEMORY_HPP
+
+#include <Config.hpp>
+#include <Constants.hpp>
+
+// The 13-bit address space is split into 64 pages of 128 bytes
+constexpr unsigned MEMORY_PAGE_SHIFT = 7;
+constexpr unsigned MEMORY_PAGE_SIZE = (1 << MEMORY_PAGE_SHIFT);
+constexpr unsigned MEMORY_PAGE_COUNT = (ADDRESS_MASK + 1) >> MEMORY_PAGE_SHIFT;
+
+// What handles an access to a page that can't be accessed directly
+constexpr byte PAGE_UNMAPPED = 0; // Reads are 0, writes are ignored
+constexpr byte PAGE_TIA      = 1;
+constexpr byte PAGE_RIOT     = 2;
+constexpr byte PAGE_ROM      = 3; // Writes are ignored
+constexpr byte PAGE_MAPPER   = 4; // Hotspots and cartridge RAM, handled by the mapper
+
+// Writes straight to RAM and cartridge RAM mark the 16 byte line they land in as dirty
+// A page has 8 lines, so its dirty bits fit in one byte
+constexpr unsigned DIRTY_LINE_SHIFT = 4;
+constexpr unsigned DIRTY_LINE_SIZE = (1 << DIRTY_LINE_SHIFT);
+
+static_assert(MEMORY_PAGE_SIZE / DIRTY_LINE_SIZE == 8, "The dirty lines of a page have to fit in a byte");
+
+struct MemoryPage
+{
+    // Memory backing the page for reads, or nullptr to go through Handler
+    const byte * Read;
+
+    // Memory backing the page for writes, or nullptr to go through Handler
+    byte * Write;
+
+    // The dirty bits for the lines of Write, a bit per DIRTY_LINE_SIZE bytes
+    byte * Dirty;
+
+    // One of PAGE_*
+    byte Handler;
+
+}; // struct MemoryPage
+
+#endif // TYPES_MEMORY_HPP
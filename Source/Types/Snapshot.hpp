@@ -0,0 +1,86 @@
+#ifndef TYPES_SNAPSHOT_HPP
+#define TYPES_SNAPSHOT_HPP
+
+#include <Config.hpp>
+
+#include <cstddef>
+
+// Number of TIA write registers, $00 - $2C
+constexpr size_t TIA_REGISTER_COUNT = 0x2D;
+
+// The machine state tools look at, copied out all at once by Emulator::TakeSnapshot
+struct MachineSnapshot
+{
+    ///
+    /// CPU
+    ///
+
+    word PC;
+
+    byte SP;
+
+    byte A;
+
+    byte X;
+
+    byte Y;
+
+    byte SR;
+
+    ///
+    /// RIOT
+    ///
+
+    byte RAM[0x80];
+
+    byte SWCHA;
+
+    byte SWACNT;
+
+    byte SWCHB;
+
+    byte SWBCNT;
+
+    byte INTIM;
+
+    byte TIMINT;
+
+    unsigned TimerInterval;
+
+    unsigned TimerCounter;
+
+    ///
+    /// TIA
+    ///
+
+    // The last value written to each register, indexed by ADDR_*, strobes are always 0
+    byte TIA[TIA_REGISTER_COUNT];
+
+    // As Emulator::Collisions
+    word Collisions;
+
+    bool WSYNC;
+
+    unsigned MemoryLine;
+
+    unsigned MemoryColumn;
+
+    ///
+    /// Cartridge
+    ///
+
+    int ROMBank;
+
+    ///
+    /// Timing
+    ///
+
+    uint64_t CPUCycleCount;
+
+    uint64_t TIACycleCount;
+
+    uint64_t InstructionCount;
+
+}; // struct MachineSnapshot
+
+#endif // TYPES_SNAPSHOT_HPP
@@ -205,4 +205,44 @@ static_assert(
     sizeof(MissileReset) == sizeof(MissileReset::_raw)
 );
 
+// The objects the TIA draws, as bits of the masks collisions are looked up from
+constexpr byte OBJECT_P0 = 1 << 0;
+constexpr byte OBJECT_P1 = 1 << 1;
+constexpr byte OBJECT_M0 = 1 << 2;
+constexpr byte OBJECT_M1 = 1 << 3;
+constexpr byte OBJECT_BL = 1 << 4;
+constexpr byte OBJECT_PF = 1 << 5;
+
+// Every combination of them
+constexpr size_t OBJECT_MASK_COUNT = 64;
+
+// The colors of what the TIA draws, in the format of the pixels being written
+template <typename Pixel>
+struct TIARenderColors
+{
+    Pixel Background;
+
+    // The playfield on either half of the screen, which are only different in score mode
+    Pixel PlayfieldLeft;
+    Pixel PlayfieldRight;
+
+    Pixel Player0;
+    Pixel Player1;
+
+}; // struct TIARenderColors
+
+// What DrawSpan draws with, worked out by WriteTIA whenever COLUxx, PF0-2 or CTRLPF are written
+struct TIARenderState
+{
+    // In the screen's pixel format
+    TIARenderColors<uint32_t> Colors;
+
+    // Palette indices, for the indexed screen
+    TIARenderColors<byte> Indices;
+
+    // Bit n is set when the playfield covers pixels 4n to 4n + 3, with reflection already applied
+    uint64_t Playfield;
+
+}; // struct TIARenderState
+
 #endif // TYPES_TIA_HPP
\ No newline at end of file
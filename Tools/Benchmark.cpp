@@ -0,0 +1,87 @@
+#include "Emulator.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Runs a ROM headless and reports interpreter throughput
+int main(int argc, char * argv[])
+{
+    // Skip the PIA and TIA to measure instruction dispatch on its own
+    bool cpuOnly = false;
+
+    // Run whole frames through DoFrame, with the block cache and everything built on it
+    bool frames = false;
+
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "--cpu-only") == 0) {
+        cpuOnly = true;
+        ++arg;
+    }
+    else if (arg < argc && strcmp(argv[arg], "--frames") == 0) {
+        frames = true;
+        ++arg;
+    }
+
+    if (arg >= argc) {
+        fprintf(stderr, "Usage: %s [--cpu-only|--frames] ROM_FILENAME [INSTRUCTION_COUNT]\n", argv[0]);
+        return 1;
+    }
+
+    const char * filename = argv[arg++];
+
+    uintmax_t instructionCount = 50'000'000;
+    if (arg < argc) {
+        instructionCount = strtoull(argv[arg], nullptr, 10);
+    }
+
+    Emulator * emu = new Emulator(true);
+
+    emu->LoadCartridge(filename);
+    emu->Reset();
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (cpuOnly) {
+        while (emu->InstructionCount < instructionCount) {
+            emu->TickCPU();
+
+            // Nothing is running the TIA to end the line
+            emu->WSYNC = false;
+        }
+    }
+    else if (frames) {
+        while (emu->InstructionCount < instructionCount) {
+            emu->DoFrame();
+        }
+    }
+    else {
+        // DoStep runs one instruction, including any WSYNC wait, and keeps the PIA and TIA in lockstep
+        while (emu->InstructionCount < instructionCount) {
+            emu->DoStep();
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    printf("Instructions:     %ju\n", emu->InstructionCount);
+    printf("CPU Cycles:       %ju\n", emu->CPUCycleCount);
+    printf("Elapsed:          %.3f s\n", seconds);
+    printf("Instructions/sec: %.0f\n", emu->InstructionCount / seconds);
+    printf("CPU Cycles/sec:   %.0f\n", emu->CPUCycleCount / seconds);
+
+    if (frames) {
+        printf("Idle skipped:     %ju\n", emu->IdleInstructionCount);
+
+        for (size_t fusion = 1; fusion < FUSION_COUNT; ++fusion) {
+            printf("Fused %s: %ju\n", FUSION_NAMES[fusion], emu->FusionCounts[fusion]);
+        }
+    }
+
+    delete emu;
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "Emulator.hpp"
+#include "ROMIndex.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Whether a file in the collection looks like a ROM, by its extension
+static bool IsROMFilename(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) {
+        return (char)tolower(c);
+    });
+
+    return (extension == ".a26" || extension == ".bin");
+}
+
+// Scans a directory tree of ROMs in parallel and writes an index of them, for tools to select ROMs from
+int main(int argc, char * argv[])
+{
+    unsigned threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "--threads") == 0) {
+        threadCount = std::max(atoi(argv[arg + 1]), 1);
+        arg += 2;
+    }
+
+    if (arg + 2 > argc) {
+        fprintf(stderr, "Usage: %s [--threads COUNT] ROM_DIRECTORY INDEX_FILENAME\n", argv[0]);
+        return 1;
+    }
+
+    const char * directory = argv[arg];
+    const char * indexFilename = argv[arg + 1];
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::string> filenames;
+
+    std::error_code error;
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+    for (std::filesystem::recursive_directory_iterator it(directory, options, error), end; it != end; it.increment(error)) {
+        if (error) {
+            break;
+        }
+
+        if (it->is_regular_file(error) && IsROMFilename(it->path())) {
+            filenames.push_back(it->path().string());
+        }
+    }
+
+    if (error) {
+        fprintf(stderr, "Failed to scan '%s': %s\n", directory, error.message().c_str());
+        return 1;
+    }
+
+    std::vector<std::pair<ROMIndexEntry, std::string>> entries;
+    std::mutex entriesMutex;
+
+    std::atomic<size_t> next = 0;
+    std::atomic<size_t> skipped = 0;
+
+    // Each worker has its own emulator, and takes files until there are none left
+    auto worker = [&]() {
+        auto emu = std::make_unique<Emulator>(true);
+
+        for (size_t i = next++; i < filenames.size(); i = next++) {
+            const std::string& filename = filenames[i];
+
+            auto image = ROMImage::Load(filename.c_str());
+            if (!image || image->Size == 0 || image->BankCount > MAX_BANKS) {
+                ++skipped;
+                continue;
+            }
+
+            emu->InsertCartridge(std::move(image));
+
+            ROMIndexEntry entry = {};
+            entry.Hash = emu->Metadata.Hash;
+            entry.Size = emu->Metadata.Size;
+            entry.Entrypoint = emu->Metadata.Entrypoint;
+            entry.MapperType = emu->Metadata.MapperType;
+
+            std::lock_guard<std::mutex> lock(entriesMutex);
+            entries.emplace_back(entry, filename);
+        }
+    };
+
+    threadCount = std::min<size_t>(threadCount, std::max<size_t>(filenames.size(), 1));
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    size_t count = entries.size();
+
+    if (!ROMIndex::Write(indexFilename, std::move(entries))) {
+        fprintf(stderr, "Failed to write index: %s\n", indexFilename);
+        return 1;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    printf("Indexed:  %zu\n", count);
+    printf("Skipped:  %zu\n", skipped.load());
+    printf("Threads:  %u\n", threadCount);
+    printf("Elapsed:  %.3f s\n", seconds);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "Emulator.hpp"
+#include "Disassembly.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Recompiles a ROM into C++ with one function per basic block, to be built into a ROM-specialized Freya2600
+int main(int argc, char * argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s ROM_FILENAME OUTPUT_FILENAME\n", argv[0]);
+        return 1;
+    }
+
+    const char * filename = argv[1];
+    const char * outputFilename = argv[2];
+
+    Emulator * emu = new Emulator(true);
+
+    emu->LoadCartridge(filename);
+
+    if (emu->ROMSize == 0) {
+        fprintf(stderr, "Nothing to recompile in '%s'\n", filename);
+        return 1;
+    }
+
+    // Blocks are looked up by bank, so nothing that switches less than a whole bank at a time
+    // FE reads all of its ROM through the mapper rather than the memory map, so its blocks would never run
+    if (emu->Mapper->SliceSize != ROM_BANK_SIZE || emu->MapperType == MAPPER_FE) {
+        fprintf(stderr, "Can't recompile '%s', %s bank switching isn't supported\n", filename, emu->Mapper->Name);
+        return 1;
+    }
+
+    FILE * file = fopen(outputFilename, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open output file: %s\n", outputFilename);
+        return 1;
+    }
+
+    fprintf(file, "// Recompiled from %s by freya2600-recompile, do not edit\n\n", filename);
+    fprintf(file, "#include \"Emulator.hpp\"\n");
+    fprintf(file, "#include \"Recompiled.hpp\"\n\n");
+
+    struct Block
+    {
+        unsigned Bank;
+        word Offset;
+        std::string Name;
+    };
+
+    std::vector<Block> blocks;
+
+    size_t numBanks = emu->ROMBankCount;
+
+    for (unsigned bank = 0; bank < numBanks; ++bank) {
+        emu->SetROMBank(bank);
+
+        // Every bank carries its own vectors for when it is switched in at power on
+        std::map<word, InstructionRecord> instructions;
+        DiscoverInstructions(emu, instructions, emu->PeekWord(0xFFFC), true);
+        DiscoverInstructions(emu, instructions, emu->PeekWord(0xFFFE), true);
+
+        // Blocks start wherever control flow can land, anything else is left to the interpreter
+        std::set<word> leaders;
+        for (const auto& [address, record] : instructions) {
+            if (!(address & 0x1000)) {
+                continue;
+            }
+
+            word offset = address & (ROM_BANK_SIZE - 1);
+
+            // Fetching from the hotspots switches banks, so that's left to the interpreter
+            if (offset >= emu->Mapper->HotspotStart) {
+                continue;
+            }
+
+            if (record.JumpDestination) {
+                leaders.insert(offset);
+            }
+
+            // Fall through of a branch, or the return from a subroutine
+            byte opcode = record.Opcodes[0];
+            if (EndsBlock(opcode)) {
+                word next = offset + 1 + OperandLength(opcode);
+                if (next < ROM_BANK_SIZE) {
+                    leaders.insert(next);
+                }
+            }
+        }
+
+        for (word leader : leaders) {
+            std::string name = fmt::format("Block_{}_{:03X}", bank, leader);
+
+            // A comment with the disassembly, and the call that runs it
+            std::vector<std::pair<std::string, std::string>> steps;
+
+            word offset = leader;
+            while (true) {
+                byte opcode = emu->ROM[bank][offset];
+                unsigned length = 1 + OperandLength(opcode);
+
+                // Don't run off the end of the bank, or into the hotspots
+                if (offset + length > emu->Mapper->HotspotStart) {
+                    break;
+                }
+
+                word operand = 0;
+                if (length == 2) {
+                    operand = emu->ROM[bank][offset + 1];
+                }
+                else if (length == 3) {
+                    operand = emu->ROM[bank][offset + 1] | (emu->ROM[bank][offset + 2] << 8);
+                }
+
+                InstructionRecord record(emu, 0xF000 | offset);
+                steps.emplace_back(
+                    record.ToString(),
+                    fmt::format("emu->RunInstruction<0x{:02X}>(0x{:04X}, {})", opcode, operand, bank)
+                );
+
+                offset += length;
+
+                if (EndsBlock(opcode) || offset >= emu->Mapper->HotspotStart || leaders.count(offset)) {
+                    break;
+                }
+            }
+
+            // The first instruction straddles the end of the bank
+            if (steps.empty()) {
+                continue;
+            }
+
+            fprintf(file, "static void %s(Emulator * emu)\n{\n", name.c_str());
+
+            for (size_t i = 0; i < steps.size(); ++i) {
+                const auto& [comment, call] = steps[i];
+
+                fprintf(file, "    // %s\n", comment.c_str());
+
+                // Leave the block as soon as the rest of it can't run, returning to DoFrame
+                if (i + 1 < steps.size()) {
+                    fprintf(file, "    if (!%s) {\n        return;\n    }\n\n", call.c_str());
+                }
+                else {
+                    fprintf(file, "    %s;\n", call.c_str());
+                }
+            }
+
+            fprintf(file, "}\n\n");
+
+            blocks.push_back({ bank, leader, name });
+        }
+    }
+
+    fprintf(file, "const uint64_t RECOMPILED_ROM_HASH = 0x%016llX;\n\n", (unsigned long long)emu->HashROM());
+
+    fprintf(file, "const RecompiledBlockEntry RECOMPILED_BLOCKS[] = {\n");
+    for (const auto& block : blocks) {
+        fprintf(file, "    { %u, 0x%03X, &%s },\n", block.Bank, block.Offset, block.Name.c_str());
+    }
+    if (blocks.empty()) {
+        fprintf(file, "    { 0, 0x000, nullptr },\n");
+    }
+    fprintf(file, "};\n\n");
+
+    fprintf(file, "const size_t RECOMPILED_BLOCK_COUNT = %zu;\n", blocks.size());
+
+    fclose(file);
+
+    printf("Recompiled %zu blocks from %zu banks into %s\n", blocks.size(), numBanks, outputFilename);
+
+    delete emu;
+
+    return 0;
+}